@@ -0,0 +1,52 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /benchmarks/BenchSupport.h
+
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/// Helpers shared by the benchmark executables.
+/// - QuietEngine swallows the engine's std::cout logging for its lifetime, so only the report is printed.
+/// - Reports go through `report()`, which writes to the real stdout.
+namespace bench {
+
+class QuietEngine {
+public:
+    QuietEngine() : previous_(std::cout.rdbuf(sink_.rdbuf())) {}
+    ~QuietEngine() { std::cout.rdbuf(previous_); }
+
+    QuietEngine(const QuietEngine&) = delete;
+    QuietEngine& operator=(const QuietEngine&) = delete;
+
+    // The real stdout while the engine is silenced
+    std::ostream& report() { return out_; }
+
+private:
+    std::ostringstream sink_;
+    std::streambuf* previous_;
+    std::ostream out_{previous_};
+};
+
+inline double elapsed_ms(const std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// First command line argument as a count, or `fallback`
+inline std::size_t count_arg(const int argc, char** argv, const std::size_t fallback)
+{
+    if (argc > 1) {
+        const long long value = std::atoll(argv[1]);
+        if (value > 0) {
+            return static_cast<std::size_t>(value);
+        }
+    }
+    return fallback;
+}
+
+} // namespace bench
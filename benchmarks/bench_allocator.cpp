@@ -0,0 +1,80 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /benchmarks/bench_allocator.cpp
+
+// Runs the allocation-heavy scripts under benchmarks/scripts on the default allocator and on the
+// size-class allocator (set_size_class_allocator(true)) and reports the time per run of each.
+//   ./bench_allocator [runs per script]
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <vector>
+
+#include "BenchSupport.h"
+#include "Scripting/ScriptManager.h"
+
+namespace fs = std::filesystem;
+
+struct Measurement {
+    double ms_per_run = 0.0;
+    std::size_t bytes_in_use = 0;
+};
+
+static Measurement measure(const fs::path& script, const bool size_class, const std::size_t runs)
+{
+    ScriptManager sm;
+    sm.set_size_class_allocator(size_class);
+    sm.init(1);
+    if (sm.load_script(script) != ScriptManager::SMLoadResult::FILE_LOAD_SUCCESS) {
+        std::cerr << "[bench] Failed to load " << script << "\n";
+        std::exit(1);
+    }
+
+    // The first runs size the heap and the slabs, only steady state is timed
+    for (int i = 0; i < 3; ++i) {
+        sm.wait_for_job(*sm.run_script(script));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < runs; ++i) {
+        const auto result = sm.wait_for_job(*sm.run_script(script));
+        if (result.status != ScriptManager::JobStatus::SUCCEEDED) {
+            std::cerr << "[bench] " << script.filename() << " failed: " << result.error << "\n";
+            std::exit(1);
+        }
+    }
+    Measurement measurement;
+    measurement.ms_per_run = bench::elapsed_ms(start) / static_cast<double>(runs);
+    for (const auto& memory : sm.state_memory()) {
+        measurement.bytes_in_use += memory.stats.bytes_in_use;
+    }
+    return measurement;
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t runs = bench::count_arg(argc, argv, 50);
+    std::vector<fs::path> scripts;
+    for (const auto& entry : fs::directory_iterator(MAPPER_BENCH_SCRIPTS)) {
+        if (entry.path().extension() == ".lua" && entry.path().stem().string().ends_with("_churn")) {
+            scripts.push_back(entry.path());
+        }
+    }
+    std::sort(scripts.begin(), scripts.end());
+
+    bench::QuietEngine quiet;
+    std::ostream& out = quiet.report();
+    out << std::fixed << std::setprecision(3);
+    out << "allocator benchmark, " << runs << " runs per script, one pooled state\n";
+    out << std::left << std::setw(20) << "script" << std::right << std::setw(14) << "default ms" << std::setw(16)
+        << "size-class ms" << std::setw(10) << "speedup" << std::setw(16) << "bytes in use" << "\n";
+    for (const fs::path& script : scripts) {
+        const Measurement system = measure(script, false, runs);
+        const Measurement size_class = measure(script, true, runs);
+        out << std::left << std::setw(20) << script.stem().string() << std::right << std::setw(14) << system.ms_per_run
+            << std::setw(16) << size_class.ms_per_run << std::setw(9) << system.ms_per_run / size_class.ms_per_run << "x"
+            << std::setw(16) << size_class.bytes_in_use << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /benchmarks/bench_batch.cpp
+
+// Pushes the same records through scripts/batch_score.lua once per record with call_entry and in batches of
+// increasing size with call_entry_batch, and reports records per second for each.
+//   ./bench_batch [records]
+
+#include <deque>
+#include <iomanip>
+#include <vector>
+
+#include "BenchSupport.h"
+#include "Scripting/ScriptManager.h"
+
+namespace fs = std::filesystem;
+
+// Jobs kept in flight, well under the executor's queue capacity
+static constexpr std::size_t max_in_flight = 64;
+
+static json make_records(const std::size_t count)
+{
+    json records = json::array();
+    for (std::size_t i = 0; i < count; ++i) {
+        records.push_back({{"x", static_cast<double>(i % 97)}, {"y", static_cast<double>(i % 89)}});
+    }
+    return records;
+}
+
+// Submits the records in chunks of `batch_size` (0 means one call_entry per record) and returns records per second
+static double measure(ScriptManager& sm, const fs::path& script, const json& records, const std::size_t batch_size)
+{
+    std::deque<ScriptManager::JobId> in_flight;
+    const auto drain_one = [&] {
+        const auto result = sm.wait_for_job(in_flight.front());
+        in_flight.pop_front();
+        if (result.status != ScriptManager::JobStatus::SUCCEEDED) {
+            std::cerr << "[bench] batch_score failed: " << result.error << "\n";
+            std::exit(1);
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t step = batch_size == 0 ? 1 : batch_size;
+    for (std::size_t first = 0; first < records.size(); first += step) {
+        if (in_flight.size() == max_in_flight) {
+            drain_one();
+        }
+        std::expected<ScriptManager::JobId, ScriptExecutor::SubmitError> job;
+        if (batch_size == 0) {
+            job = sm.call_entry(script, "score", json::array({records[first]}));
+        } else {
+            const auto last = std::min(records.size(), first + step);
+            job = sm.call_entry_batch(script, "score",
+                                      json(records.begin() + static_cast<std::ptrdiff_t>(first),
+                                           records.begin() + static_cast<std::ptrdiff_t>(last)));
+        }
+        if (!job) {
+            std::cerr << "[bench] submit failed\n";
+            std::exit(1);
+        }
+        in_flight.push_back(*job);
+    }
+    while (!in_flight.empty()) {
+        drain_one();
+    }
+    return static_cast<double>(records.size()) / (bench::elapsed_ms(start) / 1000.0);
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t count = bench::count_arg(argc, argv, 20000);
+    const fs::path script = fs::path(MAPPER_BENCH_SCRIPTS) / "batch_score.lua";
+    const json records = make_records(count);
+
+    bench::QuietEngine quiet;
+    std::ostream& out = quiet.report();
+    ScriptManager sm;
+    sm.init(1);
+    if (sm.load_script(script) != ScriptManager::SMLoadResult::FILE_LOAD_SUCCESS) {
+        std::cerr << "[bench] Failed to load " << script << "\n";
+        return 1;
+    }
+    measure(sm, script, make_records(1000), 0); // Warm the state and the entry point handle
+
+    out << std::fixed << std::setprecision(0);
+    out << "batch benchmark, " << count << " records, one pooled state\n";
+    out << std::left << std::setw(20) << "mode" << std::right << std::setw(16) << "records/s" << std::setw(12)
+        << "vs per-call" << "\n";
+    const double per_call = measure(sm, script, records, 0);
+    out << std::left << std::setw(20) << "call_entry" << std::right << std::setw(16) << per_call << std::setw(11)
+        << "1.0" << "x\n";
+    for (const std::size_t batch_size : {10u, 100u, 1000u, 10000u}) {
+        if (batch_size > count) {
+            break;
+        }
+        const double batched = measure(sm, script, records, batch_size);
+        out << std::left << std::setw(20) << ("batch of " + std::to_string(batch_size)) << std::right << std::setw(16)
+            << batched << std::setw(11) << std::setprecision(1) << batched / per_call << "x\n"
+            << std::setprecision(0);
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /benchmarks/bench_plugin_resolve.cpp
+
+// Writes plugin folders (metadata.json plus empty plugin.so and plugin.lua) forming a random dependency DAG, then
+// for growing prefixes of it registers the manifests in shuffled order and times ResolveLoadOrder and
+// ResolveLoadLevels. Reports the cost per plugin, which stays flat if resolution is linear.
+//   ./bench_plugin_resolve [plugins]
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <unistd.h>
+#include <vector>
+
+#include "BenchSupport.h"
+#include "plugins/PluginManager.h"
+
+namespace fs = std::filesystem;
+
+// Dependencies per plugin are drawn from 0..max_dependencies, always on earlier plugins, so any prefix is a closed DAG
+static constexpr int max_dependencies = 4;
+static constexpr int resolve_repeats = 5;
+
+static std::string plugin_name(const std::size_t index)
+{
+    return "bench_plugin_" + std::to_string(index);
+}
+
+static void write_manifests(const fs::path& root, const std::size_t count)
+{
+    std::mt19937 rng(1234);
+    for (std::size_t i = 0; i < count; ++i) {
+        json dependencies = json::array();
+        if (i > 0) {
+            const int wanted = std::uniform_int_distribution<int>(0, max_dependencies)(rng);
+            std::uniform_int_distribution<std::size_t> earlier(0, i - 1);
+            for (int d = 0; d < wanted; ++d) {
+                dependencies.push_back({{"name", plugin_name(earlier(rng))}, {"version", ">=1.0"}});
+            }
+        }
+        const fs::path dir = root / plugin_name(i);
+        fs::create_directories(dir);
+        std::ofstream(dir / "metadata.json") << json{{"name", plugin_name(i)}, {"version", "1.0"}, {"enabled", true},
+                                                     {"description", "generated"}, {"dependencies", dependencies}}.dump();
+        std::ofstream(dir / "plugin.so");
+        std::ofstream(dir / "plugin.lua");
+    }
+}
+
+struct Measurement {
+    double register_us = 0.0; // Per plugin: parse metadata.json from disk and register it
+    double order_us = 0.0; // Per plugin: ResolveLoadOrder
+    double levels_us = 0.0; // Per plugin: ResolveLoadLevels
+    std::size_t levels = 0;
+};
+
+static Measurement measure(const fs::path& root, const std::size_t count)
+{
+    std::vector<std::size_t> registration(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        registration[i] = i;
+    }
+    std::shuffle(registration.begin(), registration.end(), std::mt19937(99));
+
+    PluginManager plugins;
+    Measurement measurement;
+    const double per_plugin_us = 1000.0 / static_cast<double>(count);
+
+    auto start = std::chrono::steady_clock::now();
+    for (const std::size_t index : registration) {
+        if (!plugins.loadPluginMetadata(root / plugin_name(index))) {
+            std::cerr << "[bench] Failed to register " << plugin_name(index) << "\n";
+            std::exit(1);
+        }
+    }
+    measurement.register_us = bench::elapsed_ms(start) * per_plugin_us;
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < resolve_repeats; ++r) {
+        const auto order = plugins.ResolveLoadOrder();
+        if (!order || order->size() != count) {
+            std::cerr << "[bench] ResolveLoadOrder failed: " << (order ? "short order" : order.error()) << "\n";
+            std::exit(1);
+        }
+    }
+    measurement.order_us = bench::elapsed_ms(start) * per_plugin_us / resolve_repeats;
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < resolve_repeats; ++r) {
+        const auto levels = plugins.ResolveLoadLevels();
+        if (!levels) {
+            std::cerr << "[bench] ResolveLoadLevels failed: " << levels.error() << "\n";
+            std::exit(1);
+        }
+        measurement.levels = levels->size();
+    }
+    measurement.levels_us = bench::elapsed_ms(start) * per_plugin_us / resolve_repeats;
+    return measurement;
+}
+
+int main(int argc, char** argv)
+{
+    const std::size_t count = bench::count_arg(argc, argv, 10000);
+    const fs::path root = fs::temp_directory_path() / ("mapper-bench-plugins-" + std::to_string(getpid()));
+    fs::remove_all(root);
+
+    bench::QuietEngine quiet;
+    std::ostream& out = quiet.report();
+    write_manifests(root, count);
+
+    std::vector<std::size_t> sizes;
+    for (std::size_t size = count; size >= 1 && sizes.size() < 4; size /= 2) {
+        sizes.insert(sizes.begin(), size);
+    }
+
+    out << std::fixed << std::setprecision(3);
+    out << "plugin resolve benchmark, random DAG, up to " << max_dependencies << " dependencies per plugin\n";
+    out << std::right << std::setw(10) << "plugins" << std::setw(8) << "levels" << std::setw(20) << "register us/plugin"
+        << std::setw(17) << "order us/plugin" << std::setw(18) << "levels us/plugin" << "\n";
+    for (const std::size_t size : sizes) {
+        const Measurement m = measure(root, size);
+        out << std::setw(10) << size << std::setw(8) << m.levels << std::setw(20) << m.register_us << std::setw(17)
+            << m.order_us << std::setw(18) << m.levels_us << "\n";
+    }
+
+    fs::remove_all(root);
+    return 0;
+}
@@ -0,0 +1,4 @@
+-- Entry point for bench_batch: a small amount of work per record, so the per-call overhead shows
+function score(record)
+    return record.x * record.x + record.y * record.y
+end
@@ -0,0 +1,16 @@
+-- Copyright (c) 2025 Lachlan McKenna
+-- All rights reserved. No part of this code may be used, copied, or distributed without permission.
+
+-- Closures and varargs, as in callback-heavy control code
+local function make_scaler(factor)
+    return function(...)
+        local values = { ... }
+        return values[1] * factor
+    end
+end
+
+local total = 0
+for i = 1, 20000 do
+    total = total + make_scaler(i)(2, 3, 4)
+end
+return total
@@ -0,0 +1,11 @@
+-- Copyright (c) 2025 Lachlan McKenna
+-- All rights reserved. No part of this code may be used, copied, or distributed without permission.
+
+-- Number formatting and concatenation, as in logging and telemetry scripts (states only open base)
+local length = 0
+for i = 1, 10000 do
+    local line = "pose " .. tostring(i) .. ": " .. tostring(i * 0.5) .. ", " .. tostring(i * 0.25)
+    local tagged = "[" .. i .. "] " .. line
+    length = length + #tagged
+end
+return length
@@ -0,0 +1,11 @@
+-- Copyright (c) 2025 Lachlan McKenna
+-- All rights reserved. No part of this code may be used, copied, or distributed without permission.
+
+-- Small short-lived tables, the shape of per-tick poses and scan points
+local sum = 0
+for i = 1, 20000 do
+    local point = { x = i, y = i * 2, z = i * 3 }
+    local pair = { point, { i } }
+    sum = sum + pair[1].x + #pair[2]
+end
+return sum
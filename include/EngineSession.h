@@ -0,0 +1,43 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/EngineSession.h
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include "Scripting/ScriptManager.h"
+#include "plugins/PluginManager.h"
+
+/// EngineSession
+/// - One isolated engine: its own ScriptManager (primary state, pool, executors) and its own plugin set.
+/// - Any number of sessions can run in one process. Plugin libraries are loaded once and shared,
+///   while each session hands every plugin its own pluginContext, so plugin state never crosses sessions.
+/// - Plugins are shut down in reverse load order before the session's ScriptManager goes away.
+class EngineSession {
+public:
+    explicit EngineSession(std::string name = "session") : name_(std::move(name)) {}
+    ~EngineSession();
+
+    EngineSession(const EngineSession&) = delete;
+    EngineSession& operator=(const EngineSession&) = delete;
+
+    ScriptManager::SMInitResult init(std::size_t pool_size = 0);
+
+    // Discovers, orders and loads every plugin under `plugin_dir` into this session
+    void load_plugins(const std::filesystem::path& plugin_dir);
+
+    // Reloads a plugin, and the plugins depending on it, whenever its library is rebuilt
+    void start_plugin_hot_reload(std::chrono::milliseconds debounce = std::chrono::milliseconds(250));
+
+    [[nodiscard]] const std::string& name() const { return name_; }
+    [[nodiscard]] ScriptManager& scripts() { return scripts_; }
+    [[nodiscard]] const PluginManager& plugins() const { return plugins_; }
+
+private:
+    std::string name_;
+    ScriptManager scripts_;
+    PluginManager plugins_; // After scripts_, so it is destroyed first
+};
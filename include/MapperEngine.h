@@ -5,3 +5,4 @@
 #pragma once
 #include "Scripting/ScriptManager.h"
 #include "plugins/PluginManager.h"
+#include "EngineSession.h"
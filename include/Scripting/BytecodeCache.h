@@ -0,0 +1,80 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/BytecodeCache.h
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+struct lua_State;
+
+/// BytecodeCache
+/// - Compiles Lua sources to bytecode (lua_dump) in a scratch state, either the cache's own or
+///   one supplied by the caller (CompileService workers each bring their own to parse in parallel).
+/// - Persists bytecode on disk keyed by source content hash and Lua version, so unchanged
+///   scripts skip parsing on the next start.
+/// - A missing, stale or unreadable cache entry falls back to compiling the source.
+/// - A relative cache directory is resolved against each script's own directory, never the working directory.
+class BytecodeCache {
+public:
+    struct CompiledChunk {
+        std::uint64_t source_hash = 0;
+        std::shared_ptr<const std::string> bytecode;
+        bool from_cache = false; // true when the disk entry was used instead of parsing
+    };
+
+    explicit BytecodeCache(std::filesystem::path cache_dir = ".mapperscript_cache");
+    ~BytecodeCache();
+
+    BytecodeCache(const BytecodeCache&) = delete;
+    BytecodeCache& operator=(const BytecodeCache&) = delete;
+
+    // Returns bytecode for the script at `path`, from disk when the content hash matches
+    std::expected<CompiledChunk, std::string> fetch(const std::filesystem::path& path);
+
+    // Same as fetch() but parses in the caller's scratch state, so several threads can compile at once
+    std::expected<CompiledChunk, std::string> fetch(const std::filesystem::path& path, lua_State* scratch);
+
+    // Deletes the disk entry for a script, used when cached bytecode fails to load
+    void invalidate(const std::filesystem::path& path, std::uint64_t source_hash);
+
+    // An empty directory disables persistence, chunks are still compiled to bytecode.
+    // Safe to call while other threads fetch: each fetch uses the directory it saw when it started.
+    void set_cache_dir(const std::filesystem::path& cache_dir);
+    [[nodiscard]] std::filesystem::path cache_dir() const;
+
+    [[nodiscard]] std::uint64_t hits() const { return hits_; }
+    [[nodiscard]] std::uint64_t misses() const { return misses_; }
+
+    static std::uint64_t hash_content(std::string_view content);
+    static std::expected<std::string, std::string> read_file(const std::filesystem::path& path);
+
+    // Chunk name used for every script so error messages match lua_.load_file()
+    static std::string chunk_name_for(const std::filesystem::path& path) { return "@" + path.string(); }
+
+private:
+    // The chunk name is part of the key because it is baked into the bytecode's debug info
+    // Compiles already-read source text, writing the result to disk under `source_hash`
+    std::expected<CompiledChunk, std::string> compile(std::string_view source, std::string_view chunk_name,
+                                                      std::uint64_t source_hash, lua_State* scratch,
+                                                      const std::filesystem::path& dir);
+
+    // Directory holding the entries for the script at `path`, empty when persistence is off
+    [[nodiscard]] std::filesystem::path dir_for(const std::filesystem::path& path) const;
+    static std::filesystem::path entry_path(const std::filesystem::path& dir, std::uint64_t source_hash,
+                                            std::string_view chunk_name);
+
+    mutable std::mutex dir_mutex_;
+    std::filesystem::path cache_dir_;
+    std::mutex scratch_mutex_;
+    lua_State* scratch_ = nullptr; // Parsing only, no libraries opened, used by the single-argument fetch()
+    std::atomic<std::uint64_t> hits_ = 0;
+    std::atomic<std::uint64_t> misses_ = 0;
+};
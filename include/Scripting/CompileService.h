@@ -0,0 +1,77 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/CompileService.h
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <expected>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Scripting/BytecodeCache.h"
+
+/// CompileService
+/// - Worker threads that each own a scratch Lua state and turn script paths into bytecode.
+/// - Never touches a live state: callers get bytecode back and install it at their own safe point.
+/// - Shares BytecodeCache with ScriptManager, so parallel compiles also populate the disk cache.
+class CompileService {
+public:
+    struct CompileResult {
+        std::filesystem::path path;
+        std::expected<BytecodeCache::CompiledChunk, std::string> chunk;
+    };
+
+    using Completion = std::function<void(CompileResult)>;
+
+    explicit CompileService(BytecodeCache& cache) : cache_(cache) {}
+    ~CompileService() { stop(); }
+
+    CompileService(const CompileService&) = delete;
+    CompileService& operator=(const CompileService&) = delete;
+
+    // Starts `worker_count` compile workers (0 = one per core). If already running with a different count the
+    // workers are replaced and queued requests carry over to the new ones; the same count is a no-op.
+    void start(std::size_t worker_count = 0);
+    // Stops the workers and fails anything still queued
+    void stop();
+
+    // Queues one script, the future resolves once a worker has compiled (or fetched) it
+    std::future<CompileResult> submit(const std::filesystem::path& path);
+
+    // Queues one script without a future, `on_done` runs on the worker (or inline if the service is stopped)
+    void submit(const std::filesystem::path& path, Completion on_done);
+
+    // Compiles every path in parallel and returns results in the same order
+    std::vector<CompileResult> compile_all(const std::vector<std::filesystem::path>& paths);
+
+    [[nodiscard]] std::size_t worker_count() const;
+
+private:
+    struct Request {
+        std::filesystem::path path;
+        std::promise<CompileResult> promise;
+        Completion on_done; // Used instead of the promise when set
+    };
+
+    // Stops and joins the current workers, leaving the queue alone
+    void join_workers();
+    void enqueue(Request request);
+    static void complete(Request& request, CompileResult result);
+
+    void worker_loop();
+
+    BytecodeCache& cache_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::deque<Request> requests_;
+    std::vector<std::thread> workers_;
+    bool running_ = false; // Accepting requests, stays set while start() replaces the workers
+    bool stopping_ = false; // Tells the current workers to exit
+};
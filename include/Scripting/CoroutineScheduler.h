@@ -0,0 +1,123 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/CoroutineScheduler.h
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sol/sol.hpp>
+
+#include "Scripting/GcPolicy.h"
+#include "Scripting/LuaStatePool.h"
+
+/// CoroutineScheduler
+/// - Runs many long-lived scripts as coroutines inside one Lua state on one thread.
+/// - Each task is preempted after an instruction budget (lua_sethook count hook) and resumed round-robin.
+/// - Scripts cooperate with `wait(ms)` and `yield()`, which suspend the coroutine without blocking the thread.
+/// - Bindings and reloads are posted to the scheduler and applied between slices, never mid-resume.
+class CoroutineScheduler {
+public:
+    using TaskId = std::uint64_t;
+    using StateHook = LuaStatePool::StateHook;
+
+    enum class TaskStatus
+    {
+        READY,
+        WAITING,
+        FINISHED,
+        FAILED,
+        KILLED
+    };
+
+    struct TaskInfo {
+        TaskId id = 0;
+        std::filesystem::path path;
+        TaskStatus status = TaskStatus::READY;
+        std::uint64_t resumes = 0;
+        std::chrono::microseconds cpu_time{0};
+        std::string error;
+    };
+
+    CoroutineScheduler() = default;
+    ~CoroutineScheduler() { stop(); }
+
+    CoroutineScheduler(const CoroutineScheduler&) = delete;
+    CoroutineScheduler& operator=(const CoroutineScheduler&) = delete;
+
+    // Warms a dedicated state with `warm`, then starts the scheduler thread
+    void start(const StateHook& warm, int instruction_budget, bool size_class_allocator = false);
+
+    // Stops the thread and drops every task
+    void stop();
+
+    [[nodiscard]] bool running() const { return running_; }
+
+    // Queues a coroutine for the chunk loaded at `path`, it starts on the next slice
+    std::expected<TaskId, std::string> spawn(const std::filesystem::path& path);
+
+    bool kill(TaskId id);
+
+    // Applies `update` to the scheduler's state at the next safe point, no-op when stopped
+    void post(StateHook update);
+
+    void set_instruction_budget(int instructions) { instruction_budget_ = instructions; }
+
+    // Collector policy for the scheduler's state, applied at the next safe point; idle steps run after each round
+    void set_gc_policy(const GcPolicy& policy);
+    [[nodiscard]] GcStats gc_stats() const;
+
+    // Drops bookkeeping for tasks that have finished, failed or been killed
+    void clear_finished();
+
+    [[nodiscard]] std::vector<TaskInfo> tasks() const;
+
+    // Allocator counters for the scheduler's state, empty when stopped or on the system allocator
+    [[nodiscard]] std::optional<LuaAllocator::Stats> memory_stats() const;
+
+    // Frame arena counters for the scheduler's state, reset after every round; empty when stopped
+    [[nodiscard]] std::optional<FrameArena::Stats> frame_stats() const;
+
+private:
+    struct Task {
+        TaskInfo info;
+        sol::thread thread;
+        lua_State* co = nullptr; // Null once the coroutine has finished, failed or been killed
+        std::chrono::steady_clock::time_point wake_at{};
+    };
+
+    void run_loop();
+    void apply_pending();
+    void resume(Task& task);
+    static void register_api(sol::state& lua);
+
+    std::unique_ptr<LuaStatePool::PooledState> state_; // Only touched by the scheduler thread once started
+    std::thread thread_;
+    std::atomic_bool running_ = false;
+    std::atomic_bool stop_requested_ = false;
+    std::atomic_int instruction_budget_ = 10000;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_cv_;
+    std::map<TaskId, Task> tasks_;
+    std::vector<StateHook> pending_updates_;
+    std::vector<TaskId> pending_spawns_;
+    std::vector<TaskId> pending_kills_;
+    TaskId next_id_ = 1;
+
+    std::optional<GcPolicy> gc_policy_; // Unset leaves the state's collector as warmed
+    bool gc_policy_dirty_ = false;
+    GcStats gc_stats_;
+};
@@ -0,0 +1,108 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/EngineThread.h
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <sol/sol.hpp>
+
+/// EngineThread
+/// - Single owner of a Lua state: once started, every command touching it runs on this thread.
+/// - Commands arrive through a lock-free multi-producer queue (Vyukov MPSC, one atomic exchange per push)
+///   and are drained in batches; the thread sleeps on an atomic counter while the queue is empty.
+/// - call() returns a future for the command's result or exception; post() is fire-and-forget.
+/// - Commands issued from the engine thread itself, or while it is not running, run inline on the caller.
+/// - Producers are counted while they check running() and link, and stop() waits the count out before its last
+///   drain, so no command can be stranded in the queue with its caller blocked on the future.
+class EngineThread {
+public:
+    using Command = std::move_only_function<void(sol::state&)>;
+
+    struct Stats {
+        std::uint64_t commands = 0;
+        std::uint64_t batches = 0; // Wakeups that found work
+        std::uint64_t max_batch = 0;
+    };
+
+    explicit EngineThread(sol::state& state);
+    ~EngineThread();
+
+    EngineThread(const EngineThread&) = delete;
+    EngineThread& operator=(const EngineThread&) = delete;
+
+    // Hands the state to a new engine thread; nothing else may touch it directly afterwards
+    void start();
+
+    // Runs every command queued so far, then joins; later commands run inline on their caller
+    void stop();
+
+    [[nodiscard]] bool running() const { return running_.load(std::memory_order_acquire); }
+    [[nodiscard]] bool on_engine_thread() const { return std::this_thread::get_id() == thread_id_.load(); }
+
+    template<typename F>
+    auto call(F&& fn) -> std::future<std::invoke_result_t<F&, sol::state&>>
+    {
+        using Result = std::invoke_result_t<F&, sol::state&>;
+        std::packaged_task<Result(sol::state&)> task(std::forward<F>(fn));
+        std::future<Result> result = task.get_future();
+        if (!enter_queue()) {
+            task(*state_);
+            return result;
+        }
+        push(Command([task = std::move(task)](sol::state& lua) mutable { task(lua); }));
+        leave_queue();
+        return result;
+    }
+
+    template<typename F>
+    void post(F&& fn)
+    {
+        if (!enter_queue()) {
+            run_command(Command(std::forward<F>(fn)));
+            return;
+        }
+        push(Command(std::forward<F>(fn)));
+        leave_queue();
+    }
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    struct Node {
+        std::atomic<Node*> next = nullptr;
+        Command command;
+    };
+
+    // True if the command should be queued, in which case leave_queue() must follow the push
+    bool enter_queue();
+    void leave_queue();
+    void push(Command command);
+    Node* pop(); // Consumer only, null when empty or a push is mid-link
+    void run_loop();
+    void drain();
+    void run_command(Command command);
+
+    sol::state* state_;
+    std::thread thread_;
+    std::atomic<std::thread::id> thread_id_{};
+    std::atomic_bool running_ = false;
+    std::atomic_bool stop_requested_ = false;
+
+    alignas(64) std::atomic<Node*> head_; // Producers exchange here
+    alignas(64) Node* tail_; // Consumer end, always a stub whose command has been taken
+    alignas(64) std::atomic<std::uint64_t> pushed_ = 0; // Bumped after each link, the consumer waits on it
+    std::atomic<std::uint32_t> producers_ = 0; // Between enter_queue and leave_queue
+
+    std::atomic<std::uint64_t> commands_ = 0;
+    std::atomic<std::uint64_t> batches_ = 0;
+    std::atomic<std::uint64_t> max_batch_ = 0;
+};
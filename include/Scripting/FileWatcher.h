@@ -0,0 +1,94 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/FileWatcher.h
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// FileWatcher
+/// - Watches individual files through one inotify watch per parent directory (Linux), so thousands of
+///   scripts in a handful of folders cost a handful of kernel watches and no CPU while idle.
+/// - Directory watches also catch editors that save by writing a temp file and renaming it over the original.
+/// - Events are coalesced per file and delivered once the file has been quiet for the debounce window,
+///   so a save burst (truncate, write, write, close) becomes one change.
+/// - Other platforms fall back to polling last_write_time.
+class FileWatcher {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Change {
+        std::filesystem::path path; // As passed to watch()
+        Clock::time_point first_seen; // First event of the burst, the start of the reload latency
+    };
+
+    using ChangeHandler = std::function<void(const std::vector<Change>&)>;
+
+    FileWatcher() = default;
+    ~FileWatcher() { stop(); }
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Starts the watcher thread, `on_change` is called from it with each debounced batch
+    bool start(ChangeHandler on_change, std::chrono::milliseconds debounce = std::chrono::milliseconds(50));
+    void stop();
+
+    [[nodiscard]] bool running() const { return running_; }
+
+    // Safe to call before or after start()
+    void watch(const std::filesystem::path& path);
+    void unwatch(const std::filesystem::path& path);
+
+    [[nodiscard]] std::size_t watched_count() const;
+    [[nodiscard]] std::size_t directory_count() const;
+
+private:
+    struct WatchedDir {
+        int wd = -1; // inotify watch descriptor, -1 until the thread is running
+        std::size_t files = 0;
+    };
+
+    struct WatchedFile {
+        std::filesystem::path path; // As passed to watch()
+        std::filesystem::file_time_type last_write{}; // Only used by the polling fallback
+    };
+
+    struct PendingChange {
+        Change change;
+        Clock::time_point last_seen; // Delivered once this is older than the debounce window
+    };
+
+    static std::filesystem::path normalise(const std::filesystem::path& path);
+
+    void run_inotify();
+    void run_polling();
+    void add_directory_watch(const std::filesystem::path& dir, WatchedDir& watched);
+    void note_event(const std::filesystem::path& file, Clock::time_point now);
+    void flush_ready(Clock::time_point now);
+    void deliver(const std::vector<Change>& changes) const;
+
+    ChangeHandler on_change_;
+    std::chrono::milliseconds debounce_{50};
+    std::thread thread_;
+    std::atomic_bool running_ = false;
+    std::atomic_bool stop_requested_ = false;
+    int inotify_fd_ = -1;
+    int wake_fd_ = -1; // eventfd used to interrupt poll() on stop
+
+    mutable std::mutex mutex_;
+    std::condition_variable stop_cv_; // Wakes the polling fallback early on stop
+    std::unordered_map<std::filesystem::path, WatchedFile> files_; // Keyed by normalised path
+    std::unordered_map<std::filesystem::path, WatchedDir> dirs_;
+    std::unordered_map<int, std::filesystem::path> wd_dirs_;
+
+    std::unordered_map<std::filesystem::path, PendingChange> pending_; // Watcher thread only
+};
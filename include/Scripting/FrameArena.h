@@ -0,0 +1,168 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/FrameArena.h
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sol/sol.hpp>
+
+class FrameArena;
+
+/// FrameBuffer
+/// - Handle Lua holds to a block of doubles leased from a FrameArena (`frame.buffer(n)`).
+/// - Released by `<close>`, by `buf:release()` or at the arena's next reset, whichever comes first;
+///   the storage goes back to the arena for reuse, never to the heap.
+/// - The handle checks the lease generation on every access, so a released handle raises an error
+///   instead of reading a buffer that now belongs to someone else.
+/// - Pushed to Lua as one userdata per arena slot, cached in the registry and handed out again at the
+///   slot's next lease, so leasing in a steady-state loop creates no garbage. A handle kept past its
+///   release therefore errors only until the slot is leased again, after which it sees the new lease.
+class FrameBuffer {
+public:
+    FrameBuffer() = default;
+    FrameBuffer(FrameArena* arena, std::uint32_t slot, std::uint64_t generation)
+        : arena_(arena), slot_(slot), generation_(generation) {}
+
+    [[nodiscard]] bool valid() const;
+    [[nodiscard]] std::size_t size() const;
+
+    // Null when the handle is stale
+    [[nodiscard]] double* data() const;
+
+    void release();
+
+private:
+    friend int sol_lua_push(sol::types<FrameBuffer>, lua_State* L, const FrameBuffer& buffer);
+
+    FrameArena* arena_ = nullptr;
+    std::uint32_t slot_ = 0;
+    std::uint64_t generation_ = 0;
+};
+
+// Reuses the slot's cached userdata instead of creating a new one on every push
+int sol_lua_push(sol::types<FrameBuffer>, lua_State* L, const FrameBuffer& buffer);
+
+/// FrameArena
+/// - Per-state scratch memory for values that only live for one run (pooled states) or one
+///   scheduler round; ScriptManager resets it when the run or round ends.
+/// - Plugins place short-lived C++ results here instead of in Lua-owned userdata: `make<T>()` for
+///   objects handed to Lua by pointer, or the arena itself as a std::pmr::memory_resource for containers.
+/// - Memory is bump-allocated from blocks the arena keeps between resets, so a steady-state loop
+///   allocates nothing once the first few frames have sized it.
+/// - Objects handed out are valid until the next reset; scripts must not keep them across runs.
+/// - Counters are atomics written by the owner only, other threads may read them at any time.
+class FrameArena : public std::pmr::memory_resource {
+public:
+    struct Stats {
+        std::size_t bytes_in_use = 0; // Since the last reset
+        std::size_t bytes_reserved = 0; // Blocks kept for reuse
+        std::size_t peak_bytes = 0;
+        std::size_t buffers_leased = 0; // Frame buffers currently out
+        std::uint64_t resets = 0;
+        std::uint64_t block_allocations = 0; // Heap allocations made to grow the arena
+    };
+
+    explicit FrameArena(std::size_t block_size = 64 * 1024);
+    ~FrameArena() override;
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Arena for the run or round executing on this thread, null outside of one
+    static FrameArena* current();
+
+    /// RAII: makes `arena` current for this thread and resets it when the run or round ends
+    class Scope {
+    public:
+        explicit Scope(FrameArena& arena);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        FrameArena& arena_;
+        FrameArena* previous_;
+    };
+
+    // Constructs a T that lives until the next reset; non-trivial destructors run at reset, newest first
+    template<typename T, typename... Args>
+    T* make(Args&&... args)
+    {
+        void* memory = allocate(sizeof(T), alignof(T));
+        T* object = ::new (memory) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            auto* node = static_cast<Destructor*>(allocate(sizeof(Destructor), alignof(Destructor)));
+            *node = {[](void* p) { static_cast<T*>(p)->~T(); }, object, destructors_};
+            destructors_ = node;
+        }
+        return object;
+    }
+
+    // Leases `count` doubles, reusing a released buffer of the same capacity class when there is one
+    FrameBuffer lease_buffer(std::size_t count);
+
+    // Runs pending destructors, returns every buffer and rewinds to the first block
+    void reset();
+
+    [[nodiscard]] Stats stats() const;
+
+    // Installs the `frame` table and FrameBuffer usertype in a state
+    static void register_api(sol::state& lua);
+
+private:
+    friend class FrameBuffer;
+    friend int sol_lua_push(sol::types<FrameBuffer>, lua_State* L, const FrameBuffer& buffer);
+
+    struct Block {
+        std::unique_ptr<std::byte[]> memory;
+        std::size_t size = 0;
+    };
+
+    struct Destructor {
+        void (*destroy)(void*);
+        void* object;
+        Destructor* next;
+    };
+
+    struct BufferSlot {
+        std::vector<double> storage; // Capacity is a power of two, kept across leases
+        std::size_t size = 0;
+        std::uint64_t generation = 0; // Bumped on every release, stale handles no longer match
+        int lua_handle = LUA_NOREF; // Registry ref of the slot's userdata, dies with the state
+        bool leased = false;
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void*, std::size_t, std::size_t) override {} // Reclaimed at reset
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    BufferSlot* slot_for(std::uint32_t slot, std::uint64_t generation);
+    void release_slot(std::uint32_t slot, std::uint64_t generation);
+    void run_destructors();
+
+    std::size_t block_size_;
+    std::vector<Block> blocks_;
+    std::size_t block_index_ = 0; // Block being bumped
+    std::size_t offset_ = 0; // Into blocks_[block_index_]
+    Destructor* destructors_ = nullptr;
+
+    std::vector<BufferSlot> slots_;
+    std::vector<std::uint32_t> free_slots_;
+
+    std::atomic<std::size_t> bytes_in_use_ = 0;
+    std::atomic<std::size_t> bytes_reserved_ = 0;
+    std::atomic<std::size_t> peak_bytes_ = 0;
+    std::atomic<std::size_t> buffers_leased_ = 0;
+    std::atomic<std::uint64_t> resets_ = 0;
+    std::atomic<std::uint64_t> block_allocations_ = 0;
+};
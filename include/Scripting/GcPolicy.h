@@ -0,0 +1,58 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/GcPolicy.h
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+struct lua_State;
+
+/// GcPolicy
+/// - Collector settings for one Lua state: incremental or generational, and their tuning knobs (0 keeps Lua's default).
+/// - With `stop_during_runs`, the collector never runs on allocation; all collection happens in bounded
+///   LUA_GCSTEP work between runs or scheduler ticks, so a time-critical run never pays for a GC pause.
+struct GcPolicy {
+    enum class Mode
+    {
+        INCREMENTAL,
+        GENERATIONAL
+    };
+
+    Mode mode = Mode::INCREMENTAL;
+    int pause = 0; // Incremental: % heap growth before a new cycle (Lua default 200)
+    int stepmul = 0; // Incremental: collection speed relative to allocation (Lua default 100)
+    int stepsize = 0; // Incremental: log2 of bytes per step (Lua default 13)
+    int minormul = 0; // Generational: % growth before a minor collection (Lua default 20)
+    int majormul = 0; // Generational: % growth before a major collection (Lua default 100)
+
+    bool stop_during_runs = false;
+    int idle_step_kb = 0; // Work per LUA_GCSTEP between runs, 0 = one basic step (debt accumulated during the run is dropped)
+    std::chrono::microseconds idle_budget{500}; // Time cap for the steps after one run or tick
+    std::size_t full_collect_above_kb = 0; // With the collector stopped, do a full cycle when the heap passes this (0 = never)
+};
+
+struct GcStats {
+    std::size_t heap_bytes = 0; // Sampled after the last run or tick
+    std::size_t peak_heap_bytes = 0;
+    std::uint64_t steps = 0;
+    std::uint64_t cycles = 0; // Cycles finished by idle steps or full collections
+    std::uint64_t full_collections = 0;
+    std::chrono::microseconds pause_total{0}; // Time spent in idle steps and full collections
+    std::chrono::microseconds pause_max{0}; // Longest single idle window
+};
+
+/// GcController
+/// - Applies a GcPolicy to a state and does the between-runs collection work for it.
+/// - Only called by the thread that currently owns the state.
+class GcController {
+public:
+    static void apply(lua_State* L, const GcPolicy& policy);
+
+    // Bounded collection after a run or tick, updates `stats`
+    static void idle_step(lua_State* L, const GcPolicy& policy, GcStats& stats);
+
+    static std::size_t heap_bytes(lua_State* L);
+};
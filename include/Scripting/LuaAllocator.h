@@ -0,0 +1,83 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/LuaAllocator.h
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// LuaAllocator
+/// - lua_Alloc for one Lua state: blocks up to 256 bytes come from size-class slabs (16-byte steps),
+///   larger blocks go to the system allocator.
+/// - Lua passes the old size on every free and realloc, so blocks carry no header.
+/// - Owned by a single state and only called by whichever thread holds that state, so it takes no locks.
+/// - Counters are atomics written by the owner only, other threads may read them at any time.
+class LuaAllocator {
+public:
+    struct Stats {
+        std::size_t bytes_in_use = 0; // What Lua asked for and has not freed
+        std::size_t slab_bytes = 0; // Reserved for small blocks, in use or on free lists
+        std::size_t large_bytes = 0; // Live blocks served by the system allocator
+        std::uint64_t small_allocs = 0;
+        std::uint64_t large_allocs = 0;
+    };
+
+    LuaAllocator() = default;
+    ~LuaAllocator();
+
+    LuaAllocator(const LuaAllocator&) = delete;
+    LuaAllocator& operator=(const LuaAllocator&) = delete;
+
+    // Matches lua_Alloc, `ud` is the LuaAllocator
+    static void* allocate(void* ud, void* ptr, std::size_t osize, std::size_t nsize);
+
+    [[nodiscard]] Stats stats() const;
+
+    static constexpr std::size_t max_small = 256;
+    static constexpr std::size_t granularity = 16;
+    static constexpr std::size_t slab_size = 64 * 1024;
+
+private:
+    static constexpr std::size_t class_count = max_small / granularity;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct SizeClass {
+        FreeBlock* free_list = nullptr;
+        char* bump = nullptr; // Next never-used block in the newest slab
+        char* bump_end = nullptr;
+    };
+
+    static std::size_t class_of(std::size_t size) { return (size + granularity - 1) / granularity - 1; }
+
+    void* alloc_small(std::size_t size);
+    void free_small(void* ptr, std::size_t size);
+    void* realloc(void* ptr, std::size_t osize, std::size_t nsize);
+
+    // A system block Lua now sizes as small, left behind by a shrink that could not move it
+    [[nodiscard]] bool is_foreign(const void* ptr) const;
+
+    // Single writer, so a relaxed load and store is enough and avoids a locked add
+    static void add(std::atomic<std::size_t>& counter, std::ptrdiff_t delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+    static void bump(std::atomic<std::uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    std::array<SizeClass, class_count> classes_{};
+    std::vector<void*> slabs_;
+    std::size_t foreign_blocks_ = 0; // Usually 0, so small frees only search the slabs after a failed shrink
+
+    std::atomic<std::size_t> bytes_in_use_ = 0;
+    std::atomic<std::size_t> slab_bytes_ = 0;
+    std::atomic<std::size_t> large_bytes_ = 0;
+    std::atomic<std::uint64_t> small_allocs_ = 0;
+    std::atomic<std::uint64_t> large_allocs_ = 0;
+};
@@ -0,0 +1,134 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/LuaStatePool.h
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sol/sol.hpp>
+
+#include "Scripting/FrameArena.h"
+#include "Scripting/LuaAllocator.h"
+
+/// LuaStatePool
+/// - Owns N independent Lua states so scripts can run concurrently.
+/// - States are kept warm by ScriptManager: libraries opened, plugin bindings replayed, chunks loaded.
+/// - A run leases an idle state and hands it back when the lease goes out of scope.
+class LuaStatePool {
+public:
+    // Entry point handles of one script in one state, valid for the chunk version whose top level defined them
+    struct EntryPoints {
+        std::uint64_t version = 0;
+        sol::table exports; // The table the chunk returned, if any
+        std::unordered_map<std::string, sol::protected_function> functions;
+    };
+
+    struct PooledState {
+        PooledState() = default;
+        explicit PooledState(std::unique_ptr<LuaAllocator> state_allocator)
+            : allocator(std::move(state_allocator)), lua(sol::default_at_panic, &LuaAllocator::allocate, allocator.get()) {}
+
+        std::unique_ptr<LuaAllocator> allocator; // Null for the system allocator, declared first so it outlives lua
+        FrameArena frame; // Scratch for one run or scheduler round, outlives lua like the allocator
+        sol::state lua;
+        std::unordered_map<std::filesystem::path, sol::protected_function> chunks; // this state's copy of every loaded script
+        std::unordered_map<std::filesystem::path, sol::environment> environments; // per-script globals, kept across reloads
+        std::unordered_map<std::filesystem::path, EntryPoints> entry_points; // resolved per chunk version
+        std::unordered_map<std::filesystem::path, std::uint64_t> chunk_versions; // version of each installed chunk
+        std::uint64_t synced_generation = 0; // registry generation this state last caught up with
+        std::uint64_t gc_policy_version = 0; // GC policy version last applied to this state
+        std::size_t index = 0;
+        bool busy = false;
+    };
+
+    using StateHook = std::function<void(PooledState&)>;
+
+    struct StateMemory {
+        std::size_t index = 0;
+        LuaAllocator::Stats stats; // Zero on the system allocator
+        FrameArena::Stats frame;
+    };
+
+    // Creates a state on the size-class allocator or on the system one
+    static std::unique_ptr<PooledState> make_state(bool size_class_allocator);
+
+    /// RAII handle to a leased state, returns it to the pool on destruction
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(LuaStatePool* pool, PooledState* state) : pool_(pool), state_(state) {}
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease(Lease&& other) noexcept : pool_(other.pool_), state_(other.state_) {
+            other.pool_ = nullptr;
+            other.state_ = nullptr;
+        }
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                release();
+                pool_ = other.pool_;
+                state_ = other.state_;
+                other.pool_ = nullptr;
+                other.state_ = nullptr;
+            }
+            return *this;
+        }
+        ~Lease() { release(); }
+
+        PooledState* operator->() const { return state_; }
+        PooledState& operator*() const { return *state_; }
+        explicit operator bool() const { return state_ != nullptr; }
+
+        void release() {
+            if (pool_ && state_) {
+                pool_->give_back(state_);
+            }
+            pool_ = nullptr;
+            state_ = nullptr;
+        }
+
+    private:
+        LuaStatePool* pool_ = nullptr;
+        PooledState* state_ = nullptr;
+    };
+
+    // Grows or shrinks the pool to `count` states, new states are passed through `warm` before they can be leased
+    void resize(std::size_t count, const StateHook& warm);
+
+    // Blocks until a state is idle and leases it
+    Lease acquire();
+
+    // Leases an idle state if one is free right now, otherwise returns an empty lease
+    Lease try_acquire();
+
+    // Applies `fn` to every state, waiting for each one to finish its current run first
+    void for_each(const StateHook& fn);
+
+    [[nodiscard]] std::size_t size() const;
+    [[nodiscard]] std::size_t idle_count() const;
+
+    // Applies to states created by later resizes
+    void set_size_class_allocator(bool enabled) { size_class_allocator_ = enabled; }
+
+    // Allocator counters for every state on the size-class allocator, readable while states are busy
+    [[nodiscard]] std::vector<StateMemory> memory_stats() const;
+
+private:
+    void give_back(PooledState* state);
+
+    mutable std::mutex mutex_;
+    std::condition_variable idle_cv_;
+    std::vector<std::unique_ptr<PooledState>> states_;
+    std::atomic_bool size_class_allocator_ = false;
+};
@@ -0,0 +1,64 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/ModuleGraph.h
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/// ModuleGraph
+/// - Records which file required which module, as seen by the tracking `require` every state gets.
+/// - Shared by all states: the graph is the same wherever a module was first loaded.
+/// - A changed module file invalidates itself and every module that transitively requires it;
+///   each state drops those names from package.loaded at its next `require`, so they are re-required fresh.
+class ModuleGraph {
+public:
+    // Records `requirer` -> `module_file`, returns true the first time `module_file` is seen
+    bool record(const std::filesystem::path& requirer, const std::string& name, const std::filesystem::path& module_file);
+
+    [[nodiscard]] std::optional<std::filesystem::path> file_for(const std::string& name) const;
+    [[nodiscard]] bool is_module(const std::filesystem::path& file) const;
+
+    // Files that require `file`, directly or transitively (scripts and modules alike)
+    [[nodiscard]] std::vector<std::filesystem::path> dependents_of(const std::filesystem::path& file) const;
+
+    // Invalidates each changed module whose content hash moved, plus its transitive dependents.
+    // Returns the module names invalidated, empty when nothing actually changed.
+    std::vector<std::string> invalidate(const std::vector<std::filesystem::path>& changed_files);
+
+    [[nodiscard]] std::uint64_t epoch() const { return epoch_; }
+
+    // Module names a state synced at `since` must drop from package.loaded
+    [[nodiscard]] std::vector<std::string> invalidated_since(std::uint64_t since) const;
+
+    static std::filesystem::path normalise(const std::filesystem::path& path);
+
+private:
+    struct Module {
+        std::unordered_set<std::string> names; // Every name it has been required as
+        std::unordered_set<std::filesystem::path> dependents; // Files that require it
+        std::uint64_t source_hash = 0;
+    };
+
+    struct Invalidation {
+        std::uint64_t epoch = 0;
+        std::vector<std::string> names;
+    };
+
+    static constexpr std::size_t max_history = 256; // States further behind drop every tracked module
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::filesystem::path, Module> modules_;
+    std::unordered_map<std::string, std::filesystem::path> names_;
+    std::deque<Invalidation> history_;
+    std::atomic<std::uint64_t> epoch_ = 0;
+};
@@ -0,0 +1,60 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/RunWatchdog.h
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+struct lua_State;
+struct lua_Debug;
+
+/// RunLimits
+/// - Per-run instruction budget and wall-clock deadline, 0 disables either one.
+struct RunLimits {
+    std::uint64_t max_instructions = 0;
+    std::chrono::milliseconds deadline{0};
+
+    [[nodiscard]] bool enabled() const { return max_instructions > 0 || deadline.count() > 0; }
+};
+
+/// RunWatchdog
+/// - Arms a count hook on a state for the length of one run (RAII) and aborts the run once it
+///   goes over its instruction budget or past its deadline.
+/// - Once tripped the hook fires on every instruction, so a script that catches the error with
+///   pcall is aborted again straight away and cannot keep running.
+/// - Coroutines created during the run inherit the hook.
+class RunWatchdog {
+public:
+    enum class Verdict
+    {
+        NONE,
+        INSTRUCTION_BUDGET,
+        DEADLINE
+    };
+
+    RunWatchdog(lua_State* L, const RunLimits& limits);
+    ~RunWatchdog();
+
+    RunWatchdog(const RunWatchdog&) = delete;
+    RunWatchdog& operator=(const RunWatchdog&) = delete;
+
+    [[nodiscard]] Verdict verdict() const { return verdict_; }
+    [[nodiscard]] std::uint64_t instructions() const { return instructions_; }
+
+    // Distinct message for the job result, empty when the run was not aborted
+    [[nodiscard]] std::string describe() const;
+
+private:
+    static void hook(lua_State* L, lua_Debug* ar);
+
+    lua_State* L_ = nullptr;
+    RunLimits limits_;
+    int interval_ = 0; // Instructions between hook calls
+    std::uint64_t instructions_ = 0;
+    std::chrono::steady_clock::time_point deadline_at_{};
+    Verdict verdict_ = Verdict::NONE;
+    RunWatchdog* previous_ = nullptr; // Watchdog of an outer run on this thread, restored on disarm
+};
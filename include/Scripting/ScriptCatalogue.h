@@ -0,0 +1,50 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/ScriptCatalogue.h
+
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// ScriptCatalogue
+/// - Index of scripts that are known but not compiled: path, size, content hash and modification time.
+/// - Lets a session list a large library at startup while only compiling what it actually runs.
+/// - Counts runs per script so the next session can prefetch the ones that were used.
+class ScriptCatalogue {
+public:
+    struct Entry {
+        std::filesystem::path path;
+        std::uintmax_t size = 0;
+        std::uint64_t source_hash = 0;
+        std::filesystem::file_time_type last_write{};
+        std::uint64_t runs = 0; // This session plus whatever was restored from the last one
+    };
+
+    // Reads and hashes the file, replacing any existing entry but keeping its run count
+    std::expected<Entry, std::string> index(const std::filesystem::path& path);
+
+    // Indexes every .lua file under `dir`, returns how many were added
+    std::size_t index_directory(const std::filesystem::path& dir);
+
+    [[nodiscard]] bool contains(const std::filesystem::path& path) const;
+    [[nodiscard]] std::optional<Entry> find(const std::filesystem::path& path) const;
+    [[nodiscard]] std::vector<Entry> entries() const;
+    [[nodiscard]] std::size_t size() const;
+
+    void record_run(const std::filesystem::path& path);
+    void set_runs(const std::filesystem::path& path, std::uint64_t runs);
+
+    // The `count` most-run scripts, most-run first, scripts never run are left out
+    [[nodiscard]] std::vector<std::filesystem::path> most_run(std::size_t count) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<std::filesystem::path, Entry> entries_;
+};
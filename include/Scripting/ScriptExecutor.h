@@ -0,0 +1,143 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/ScriptExecutor.h
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <expected>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+/// ScriptExecutor
+/// - Persistent worker threads that drain a bounded priority queue of script runs.
+/// - Every submission gets a JobId that can be polled, waited on or cancelled while still queued.
+/// - Results are kept for a bounded history so callers can collect them after the fact.
+class ScriptExecutor {
+public:
+    using JobId = std::uint64_t;
+
+    enum class JobPriority
+    {
+        LOW = 0,
+        NORMAL = 1,
+        HIGH = 2,
+        CRITICAL = 3
+    };
+
+    enum class JobStatus
+    {
+        QUEUED,
+        RUNNING,
+        SUCCEEDED,
+        FAILED,
+        KILLED, // Aborted by the run watchdog: instruction budget or deadline exceeded
+        CANCELLED,
+        UNKNOWN // id was never issued or its result has been evicted
+    };
+
+    enum class SubmitError
+    {
+        QUEUE_FULL,
+        SCRIPT_NOT_LOADED,
+        EXECUTOR_STOPPED
+    };
+
+    struct JobResult {
+        JobStatus status = JobStatus::UNKNOWN;
+        json values = json::array(); // Values returned by the chunk, converted from the protected_function_result
+        std::string error;
+        std::chrono::microseconds run_time{0};
+    };
+
+    // What a job runs: the whole chunk, or one of the script's entry points with arguments
+    struct JobRequest {
+        std::filesystem::path path;
+        std::string entry; // Empty runs the chunk
+        json args = json::array(); // Passed to the entry point, one Lua value per element
+        bool batch = false; // args holds records instead, the entry is called once per record
+    };
+
+    // Runs one request to completion on the calling worker thread
+    using Runner = std::function<JobResult(const JobRequest&)>;
+
+    explicit ScriptExecutor(std::size_t queue_capacity = 256, std::size_t result_history = 1024)
+        : queue_capacity_(queue_capacity), result_history_(result_history) {}
+    ~ScriptExecutor() { stop(); }
+
+    ScriptExecutor(const ScriptExecutor&) = delete;
+    ScriptExecutor& operator=(const ScriptExecutor&) = delete;
+
+    // Starts (or resizes to) `worker_count` workers, the runner is only replaced while no workers exist
+    void start(std::size_t worker_count, Runner runner);
+
+    // Stops all workers, queued jobs are marked CANCELLED
+    void stop();
+
+    std::expected<JobId, SubmitError> submit(const std::filesystem::path& path, JobPriority priority = JobPriority::NORMAL);
+    std::expected<JobId, SubmitError> submit(JobRequest request, JobPriority priority = JobPriority::NORMAL);
+
+    // Removes a job that has not started yet, returns false if it is already running or finished
+    bool cancel(JobId id);
+
+    [[nodiscard]] JobStatus status(JobId id) const;
+
+    // Returns the result if the job has finished (or was cancelled), without blocking
+    [[nodiscard]] std::optional<JobResult> result(JobId id) const;
+
+    // Blocks until the job finishes and returns its result
+    JobResult wait(JobId id);
+
+    void set_queue_capacity(std::size_t capacity);
+    [[nodiscard]] std::size_t queued_count() const;
+    [[nodiscard]] std::size_t worker_count() const;
+
+    static std::string_view to_string(JobStatus status);
+    static std::string_view to_string(SubmitError error);
+
+private:
+    struct Job {
+        JobRequest request;
+        JobPriority priority = JobPriority::NORMAL;
+        JobResult result;
+    };
+
+    // Ordered so that begin() is the highest priority, oldest submission
+    using QueueKey = std::pair<int, JobId>;
+
+    void worker_loop(std::size_t index);
+    void finish(JobId id, JobResult result);
+    // Under mutex_: frees the finished job's request and evicts the oldest results beyond result_history_
+    void retire(JobId id);
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+
+    std::set<QueueKey> queue_;
+    std::unordered_map<JobId, Job> jobs_;
+    std::deque<JobId> finished_order_; // Oldest finished results are evicted first
+
+    std::vector<std::thread> workers_;
+    std::size_t target_workers_ = 0;
+    std::size_t queue_capacity_;
+    std::size_t result_history_;
+    JobId next_id_ = 1;
+    bool stopping_ = false;
+    Runner runner_;
+};
@@ -18,6 +18,22 @@
 #include <optional>
 #include <thread>
 #include <chrono>
+#include <limits>
+#include <map>
+#include <mutex>
+
+#include "Scripting/LuaStatePool.h"
+#include "Scripting/ScriptExecutor.h"
+#include "Scripting/CoroutineScheduler.h"
+#include "Scripting/BytecodeCache.h"
+#include "Scripting/CompileService.h"
+#include "Scripting/FileWatcher.h"
+#include "Scripting/ScriptRegistry.h"
+#include "Scripting/ModuleGraph.h"
+#include "Scripting/ScriptCatalogue.h"
+#include "Scripting/RunWatchdog.h"
+#include "Scripting/TickExecutor.h"
+#include "Scripting/EngineThread.h"
 
 
 using json = nlohmann::json;
@@ -39,14 +55,186 @@ public:
     };
 
 
-    SMInitResult init();
+    using JobId = ScriptExecutor::JobId;
+    using JobPriority = ScriptExecutor::JobPriority;
+    using JobStatus = ScriptExecutor::JobStatus;
+    using JobResult = ScriptExecutor::JobResult;
+    using JobRequest = ScriptExecutor::JobRequest;
 
+    struct StateGcStats {
+        std::size_t index = 0;
+        GcStats stats;
+    };
+
+    // Hot reload counters, latency runs from the first file event of a save to the new bytecode being published
+    struct HotReloadStats {
+        std::uint64_t reloads = 0;
+        std::uint64_t unchanged_skipped = 0; // Save events whose content hash matched the loaded chunk
+        std::uint64_t failures = 0;
+        std::uint64_t modules_invalidated = 0; // package.loaded entries dropped because a required file changed
+        std::chrono::microseconds last_latency{0};
+        std::chrono::microseconds max_latency{0};
+        std::chrono::microseconds total_latency{0};
+    };
+
+    // Runs of one script aborted by the watchdog
+    struct KillStats {
+        std::uint64_t budget_kills = 0;
+        std::uint64_t deadline_kills = 0;
+    };
+
+    ScriptManager() = default;
+    ~ScriptManager();
+
+    // Initializes the primary Lua state and a pool of `pool_size` worker states (0 = one per core)
+    SMInitResult init(std::size_t pool_size = 0);
+
+    // Resizes the worker pool and executor, new states are warmed with every binding and loaded script
+    void set_pool_size(std::size_t pool_size);
+
+    [[nodiscard]] std::size_t pool_size() const { return pool_.size(); }
+
+    // Brings the manager to a single-threaded, fork-safe point: stops the watcher, scheduler, tick executor,
+    // executor (queued jobs are cancelled), compile service and engine thread, after installing every loaded
+    // chunk into every pooled state so a forked child starts warm. Coroutine tasks and ticks do not survive it.
+    void prepare_fork();
+
+    // Which side of fork() resume_after_fork() runs on
+    enum class ForkSide
+    {
+        PARENT,
+        CHILD
+    };
+
+    // Restarts the engine thread, compile service and executor stopped by prepare_fork(). In the parent it also
+    // restarts the watcher, scheduler and tick executor that were running, with the settings they were started with;
+    // a child leaves them stopped.
+    void resume_after_fork(ForkSide side = ForkSide::PARENT);
+
+    // Stops every thread that runs scripts on pooled states: the watcher, tick executor, scheduler and executor
+    // (queued jobs are cancelled). The engine thread keeps running, so plugins can still shut down through it.
+    void stop_workers();
+
+    // Puts worker and scheduler states created from now on onto the per-state size-class allocator; call before init()
+    void set_size_class_allocator(bool enabled) {
+        size_class_allocator_ = enabled;
+        pool_.set_size_class_allocator(enabled);
+    }
+
+    // Bytes in use and slab usage per pooled state on the size-class allocator, plus frame arena usage
+    [[nodiscard]] std::vector<LuaStatePool::StateMemory> state_memory() const { return pool_.memory_stats(); }
+    [[nodiscard]] std::optional<LuaAllocator::Stats> scheduler_memory() const { return scheduler_.memory_stats(); }
+    [[nodiscard]] std::optional<FrameArena::Stats> scheduler_frame_memory() const { return scheduler_.frame_stats(); }
+
+    // Collector mode and tuning for every worker state, applied to each one at its next lease
+    void set_gc_policy(const GcPolicy& policy);
+    [[nodiscard]] GcPolicy gc_policy() const;
+
+    // Same for the scheduler's state, whose idle steps run between ticks
+    void set_scheduler_gc_policy(const GcPolicy& policy) { scheduler_.set_gc_policy(policy); }
+
+    // Heap size and collection pauses per worker state, sampled after each run
+    [[nodiscard]] std::vector<StateGcStats> gc_stats() const;
+    [[nodiscard]] GcStats scheduler_gc_stats() const { return scheduler_.gc_stats(); }
+
+
+    // Each script runs with its own globals that fall back to the shared ones (libraries, plugin namespaces).
+    // On by default; applies to chunks installed after the call, so set it before loading scripts.
+    void set_isolated_globals(bool isolated) { isolated_globals_ = isolated; }
+    [[nodiscard]] bool isolated_globals() const { return isolated_globals_; }
 
     // Loads a Lua script from the given path and keeps it ready to run
     SMLoadResult load_script(const std::filesystem::path& path);
 
-    // Executes a loaded script by its path (only one runs at a time)
-    std::future<void> run_script(const std::filesystem::path& path);
+    // Queues a loaded script for execution on a pooled state, higher priorities run first
+    std::expected<JobId, ScriptExecutor::SubmitError> run_script(const std::filesystem::path& path,
+                                                                 JobPriority priority = JobPriority::NORMAL);
+
+    // Instruction budget and deadline for every pooled run without limits of its own, off by default
+    void set_default_run_limits(const RunLimits& limits);
+    // Per-script override, an empty optional goes back to the defaults
+    void set_run_limits(const std::filesystem::path& path, std::optional<RunLimits> limits);
+    [[nodiscard]] RunLimits run_limits(const std::filesystem::path& path) const;
+
+    // Scripts that have had at least one run aborted, runs over their limits finish as JobStatus::KILLED
+    [[nodiscard]] std::map<std::filesystem::path, KillStats> script_kill_stats() const;
+
+    // Calls `entry`, a function the script defines as a global or returns in a table, with `args` on a pooled state.
+    // The chunk's top level runs once per state and chunk version to define it; later calls are one protected call.
+    std::expected<JobId, ScriptExecutor::SubmitError> call_entry(const std::filesystem::path& path, const std::string& entry,
+                                                                 json args = json::array(),
+                                                                 JobPriority priority = JobPriority::NORMAL);
+
+    // Calls `entry` once per element of `records` inside a single protected call on one pooled state.
+    // JobResult::values holds each call's first return value, in record order; the first error fails the batch.
+    std::expected<JobId, ScriptExecutor::SubmitError> call_entry_batch(const std::filesystem::path& path,
+                                                                       const std::string& entry, json records,
+                                                                       JobPriority priority = JobPriority::NORMAL);
+
+    // Job queries, see ScriptExecutor
+    [[nodiscard]] JobStatus job_status(JobId id) const { return executor_.status(id); }
+    [[nodiscard]] std::optional<JobResult> job_result(JobId id) const { return executor_.result(id); }
+    JobResult wait_for_job(JobId id) { return executor_.wait(id); }
+    bool cancel_job(JobId id) { return executor_.cancel(id); }
+    void set_queue_capacity(std::size_t capacity) { executor_.set_queue_capacity(capacity); }
+
+    // Starts the cooperative scheduler: one extra state and thread that time-slices coroutine tasks
+    void start_scheduler(int instruction_budget = 10000);
+
+    void stop_scheduler() { scheduler_.stop(); }
+
+    // Runs a loaded chunk as a coroutine task on the scheduler, scripts can call wait(ms) and yield()
+    std::expected<CoroutineScheduler::TaskId, std::string> spawn_task(const std::filesystem::path& path);
+
+    // Spawns one task per loaded script
+    std::vector<CoroutineScheduler::TaskId> spawn_loaded_scripts();
+
+    bool kill_task(CoroutineScheduler::TaskId id) { return scheduler_.kill(id); }
+
+    [[nodiscard]] std::vector<CoroutineScheduler::TaskInfo> scheduler_tasks() const { return scheduler_.tasks(); }
+
+    // Starts the fixed-period tick executor: one extra state and thread, realtime_priority > 0 requests SCHED_FIFO
+    void start_tick_executor(int realtime_priority = 0);
+
+    void stop_tick_executor() { ticker_.stop(); }
+
+    // Runs a loaded (or catalogued) script every `period`, earliest deadline first between rates.
+    // With `entry` set, that entry point is called instead, with the seconds since its previous tick.
+    std::expected<TickExecutor::TickId, std::string> schedule_tick(const std::filesystem::path& path,
+                                                                   std::chrono::microseconds period,
+                                                                   const std::string& entry = {});
+
+    bool cancel_tick(TickExecutor::TickId id) { return ticker_.remove(id); }
+
+    // Jitter, run time, overruns, deadline misses and skipped releases per scheduled script
+    [[nodiscard]] std::vector<TickExecutor::TickInfo> tick_stats() const { return ticker_.ticks(); }
+
+    // Directory for precompiled chunks keyed by source hash, empty disables the on-disk cache
+    void set_bytecode_cache_dir(const std::filesystem::path& dir) { bytecode_cache_.set_cache_dir(dir); }
+    [[nodiscard]] const BytecodeCache& bytecode_cache() const { return bytecode_cache_; }
+
+    // Number of scratch-state workers used for parallel restore and off-thread reloads (0 = one per core)
+    void set_compile_workers(std::size_t worker_count) { compile_service_.start(worker_count); }
+
+    [[nodiscard]] bool is_loaded(const std::filesystem::path& path) const;
+
+    // Catalogue mode: restore_scripts_from_json only indexes scripts, each one compiles on its first run
+    void set_lazy_loading(bool lazy) { lazy_loading_ = lazy; }
+    [[nodiscard]] bool lazy_loading() const { return lazy_loading_; }
+
+    // Indexes a script (path, size, content hash) without compiling it, run_script compiles it on demand
+    SMLoadResult catalogue_script(const std::filesystem::path& path);
+
+    // Indexes every .lua file under `dir`, returns how many were added
+    std::size_t catalogue_directory(const std::filesystem::path& dir) { return catalogue_.index_directory(dir); }
+
+    // Compiles catalogued scripts in the background so their first run does not wait on the parser
+    void prefetch_scripts(const std::vector<std::filesystem::path>& paths);
+
+    // How many of the previous session's most-run scripts a lazy restore prefetches
+    void set_prefetch_count(std::size_t count) { prefetch_count_ = count; }
+
+    [[nodiscard]] const ScriptCatalogue& catalogue() const { return catalogue_; }
 
     // Saves loaded script paths to disk so they can be restored later
     bool save_loaded_scripts(const std::filesystem::path& json_out_path = "scripts.json") const;
@@ -54,48 +242,86 @@ public:
     // Loads previously saved script paths and loads them into memory
     bool restore_scripts_from_json(const std::filesystem::path& json_in_path = "scripts.json");
 
-    // Updates watched files and reloads any that have changed
-    void start_watcher_thread();
+    // Watches every loaded script (inotify on Linux) and reloads the ones whose content changed
+    void start_watcher_thread(std::chrono::milliseconds debounce = std::chrono::milliseconds(50));
 
     void stop_watcher_thread();
 
-    // Access to the Lua state for advanced usage if needed
+    [[nodiscard]] HotReloadStats hot_reload_stats() const;
+
+    // Files that require `module_file` directly or transitively, as recorded by the tracking `require`
+    [[nodiscard]] std::vector<std::filesystem::path> module_dependents(const std::filesystem::path& module_file) const {
+        return module_graph_.dependents_of(ModuleGraph::normalise(module_file));
+    }
+
+    // Module graph epoch, bumped each time a reload invalidates tracked modules
+    [[nodiscard]] std::uint64_t module_epoch() const { return module_graph_.epoch(); }
+
+    // Module names invalidated after `epoch`, what a cached lookup made at that epoch must drop
+    [[nodiscard]] std::vector<std::string> modules_invalidated_since(const std::uint64_t epoch) const {
+        return module_graph_.invalidated_since(epoch);
+    }
+
+    // Runs `fn(sol::state&)` on the engine thread that owns the primary state, from any thread.
+    // The future carries the result or exception; called on the engine thread itself it runs inline.
+    template<typename F>
+    auto engine_call(F&& fn) { return engine_.call(std::forward<F>(fn)); }
+
+    // Same without a reply, exceptions are logged
+    template<typename F>
+    void engine_post(F&& fn) { engine_.post(std::forward<F>(fn)); }
+
+    [[nodiscard]] EngineThread::Stats engine_stats() const { return engine_.stats(); }
+
+    // Access to the primary Lua state for advanced usage if needed; after init() only from engine_call/engine_post
     const sol::state& lua_state();
     
-    // Non-const access for plugin context calls
+    // Non-const access for plugin context calls (primary state only, pooled states are not exposed).
+    // After init() the engine thread owns this state, use it only inside engine_call/engine_post.
     sol::state_view& sol_state() { return lua_; }
 
+    // Bindings are recorded so every pooled state, including ones created later, gets the same functions
+    using StateBinding = std::function<void(sol::state_view)>;
+
+    // Forgets every binding made on behalf of `owner` and sets those names to nil in the primary state, every pooled
+    // state once it is idle, and the scheduler and tick states between slices. Returns once all of them have dropped
+    // the names, so no run is still inside one of the bindings. Returns how many were dropped.
+    std::size_t drop_bindings(const std::string& owner);
+
+    // `owner` (a plugin name) lets drop_bindings take the binding back when its plugin unloads or reloads
     template<typename Func>
-    void bind_function(const std::string& name, Func&& func) {
+    void bind_function(const std::string& name, Func&& func, const std::string& owner = {}) {
         // Simple direct registration
         std::cout << "[pluginMGR] Binding function: " << name << '\n';
-        lua_.set_function(name, std::forward<Func>(func));
+        apply_binding({owner, {}, name, [name, fn = std::decay_t<Func>(std::forward<Func>(func))](sol::state_view lua) {
+            lua.set_function(name, fn);
+        }});
     }
 
     // Bind function into a Lua namespace table
     template<typename Func>
-    void bind_function_namespace(const std::string& ns, const std::string& name, Func&& func) {
+    void bind_function_namespace(const std::string& ns, const std::string& name, Func&& func, const std::string& owner = {}) {
         std::cout << "[ScriptManager] Creating/getting namespace: " << ns << "\n";
-        sol::table table = lua_[ns];
-        if (!table.valid()) {
-            std::cout << "[ScriptManager] Creating new table for namespace: " << ns << "\n";
-            table = lua_.create_table();
-            lua_[ns] = table;
-        }
-        std::cout << "[ScriptManager] Setting function " << name << " in namespace " << ns << "\n";
-        table.set_function(name, std::forward<Func>(func));
-        
+        apply_binding({owner, ns, name, [ns, name, fn = std::decay_t<Func>(std::forward<Func>(func))](sol::state_view lua) {
+            sol::table table = lua[ns].get_or_create<sol::table>();
+            table.set_function(name, fn);
+        }});
+
         // Debug: Verify the function was set
-        sol::function check = table[name];
-        std::cout << "[ScriptManager] Verification - " << ns << "." << name << " valid: " << (check.valid() ? "YES" : "NO") << "\n";
+        const bool valid = engine_.call([&ns, &name](sol::state& lua) {
+            sol::function check = lua[ns][name];
+            return check.valid();
+        }).get();
+        std::cout << "[ScriptManager] Verification - " << ns << "." << name << " valid: " << (valid ? "YES" : "NO") << "\n";
     }
 
 
     void print_fileTimes() const
     {
-        std::cout << "file count: " << file_watch_times_.size() << "\n";
-        std::cout << "times: " << file_watch_times_.begin()->first << "\n";
-        std::cout << "paths: " << file_watch_times_.begin()->second << "\n";
+        const ScriptRegistry::SnapshotPtr snapshot = registry_.snapshot();
+        std::cout << "file count: " << snapshot->scripts.size() << "\n";
+        std::cout << "times: " << snapshot->scripts.begin()->first << "\n";
+        std::cout << "paths: " << snapshot->scripts.begin()->second.last_write << "\n";
 
     }
 
@@ -107,14 +333,134 @@ private:
     // Internal helper to reload a single script
     bool reload_script(const std::filesystem::path& path);
 
-    std::atomic_bool HotReload_StopRequested = false;
-    bool Exec_running = false;
-    sol::state lua_; // The main Lua state
+    // Compiles changed scripts in parallel off-thread, then publishes the ones whose content hash changed
+    std::size_t reload_scripts(const std::vector<FileWatcher::Change>& changes);
+
+    // Swaps new bytecode into the registry as one snapshot; states install it at their next safe point
+    void publish_chunks(std::vector<std::pair<std::filesystem::path, ScriptRegistry::Entry>> entries);
 
+    // Starts a compile of a catalogued script, or joins one in flight; resolves true once it is published
+    std::shared_future<bool> compile_on_demand(const std::filesystem::path& path);
 
+    static ScriptRegistry::Entry make_entry(const std::filesystem::path& path, const BytecodeCache::CompiledChunk& chunk);
 
-    std::unordered_map<std::filesystem::path, sol::load_result> loaded_scripts_; // Loaded script cache
-    std::unordered_map<std::filesystem::path, std::filesystem::file_time_type> file_watch_times_; // Hot reload tracking
+    // Installs every chunk published since this state last synced, called only while the state is idle
+    void sync_state(LuaStatePool::PooledState& state);
+
+    struct OwnedBinding {
+        std::string owner; // Empty for bindings made outside a plugin
+        std::string ns; // Empty for globals
+        std::string name;
+        StateBinding apply;
+    };
+
+    // Records a binding and applies it to the primary state and every pooled state.
+    // A later binding of the same name replaces the recorded one, so reloads do not grow the log.
+    void apply_binding(OwnedBinding binding);
+
+    // Runs `binding` on the primary state and every pooled state without recording it. The scheduler and tick
+    // states get it between slices; with `wait_for_all`, this returns only after they have applied it or stopped.
+    void broadcast_binding(const StateBinding& binding, bool wait_for_all = false);
+
+    // Re-applies the GC policy if it changed since this state last saw it, returns the policy to run under
+    GcPolicy sync_gc_policy(LuaStatePool::PooledState& state);
+
+    // Brings a fresh pooled state up to date: libraries, bindings, loaded chunks
+    void warm_state(LuaStatePool::PooledState& state);
+
+    static sol::load_result load_bytecode(sol::state& lua, const std::filesystem::path& path, const std::string& bytecode);
+
+    // Loads already-compiled bytecode into a pooled state's own chunk cache, in the script's environment if `isolate`
+    static bool load_pooled_chunk(LuaStatePool::PooledState& state, const std::filesystem::path& path,
+                                  const std::shared_ptr<const std::string>& bytecode, bool isolate);
+
+    // The script's own globals table, created on first use: reads fall back to the state's globals, writes stay local
+    static sol::environment& script_environment(LuaStatePool::PooledState& state, const std::filesystem::path& path);
+
+    static void open_state_libraries(sol::state& lua);
+
+    // Replaces `require` with one that records the require graph and applies pending module invalidations
+    void install_module_tracking(sol::state& lua);
+
+    // Drops modules invalidated since this state last synced from its package.loaded
+    void apply_module_invalidations(lua_State* L);
+
+    void record_require(lua_State* L);
+
+    static int tracked_require(lua_State* L);
+
+    // Invalidates changed module files and their dependents in every state, returns the number of names dropped
+    std::size_t invalidate_modules(const std::vector<std::filesystem::path>& module_files);
+
+    sol::state lua_; // The main Lua state, plugins bind against this one
+    EngineThread engine_{lua_}; // Owns lua_ from init() on, every use of it goes through this thread
+
+    // Executes one chunk on a leased pooled state, called from executor workers
+    JobResult execute_on_pool(const JobRequest& request);
+
+    // Syncs `state`, runs the chunk or entry point under its limits and frame, then does the idle GC step
+    JobResult execute_on_state(LuaStatePool::PooledState& state, const JobRequest& request)
+    {
+        JobResult job;
+        execute_on_state(state, request, job);
+        return job;
+    }
+    // Same, overwriting `job` in place so a caller that keeps one (the tick thread) reuses its buffers
+    void execute_on_state(LuaStatePool::PooledState& state, const JobRequest& request, JobResult& job);
+
+    // Cached handle for `name`, running the chunk's top level first if this state has not for the current version
+    static std::expected<sol::protected_function, std::string> resolve_entry_point(LuaStatePool::PooledState& state,
+                                                                                   const std::filesystem::path& path,
+                                                                                   const std::string& name);
+
+    LuaStatePool pool_; // Worker states that run_script executes on
+    ScriptExecutor executor_; // Declared after pool_ so its workers stop before the states go away
+    CoroutineScheduler scheduler_; // Owns its own state, kept in sync through post()
+    TickExecutor ticker_; // Same, runs fixed-period scripts through execute_on_state
+    static constexpr std::size_t tick_state_index = std::numeric_limits<std::size_t>::max(); // Keeps its GC stats apart
+    std::mutex bindings_mutex_;
+    std::vector<OwnedBinding> binding_log_; // Replayed into every pooled state
+
+
+    BytecodeCache bytecode_cache_;
+
+    ScriptCatalogue catalogue_; // Known but not necessarily compiled scripts
+    std::mutex on_demand_mutex_;
+    std::unordered_map<std::filesystem::path, std::shared_future<bool>> on_demand_; // Compiles in flight
+    std::atomic_bool lazy_loading_ = false;
+    std::atomic_bool size_class_allocator_ = false;
+    std::atomic_bool isolated_globals_ = true;
+    std::atomic<std::size_t> prefetch_count_ = 8;
+    std::size_t compile_workers_before_fork_ = 0;
+
+    // Settings the watcher, scheduler and tick executor were last started with, so the parent can restart the ones
+    // prepare_fork() stopped
+    std::chrono::milliseconds watcher_debounce_{50};
+    int scheduler_budget_ = 10000;
+    int tick_priority_ = 0;
+    struct StoppedForFork {
+        bool watcher = false;
+        bool scheduler = false;
+        bool ticker = false;
+    } stopped_for_fork_;
+
+    CompileService compile_service_{bytecode_cache_};
+
+    // Loaded scripts and their watch times, read through immutable snapshots by runs, syncs and the watcher
+    ScriptRegistry registry_;
+
+    mutable std::mutex stats_mutex_; // Also guards the GC policy, per-state GC stats and run limits
+    HotReloadStats reload_stats_;
+    GcPolicy gc_policy_;
+    std::uint64_t gc_policy_version_ = 1;
+    std::map<std::size_t, GcStats> gc_stats_; // By pooled state index
+    RunLimits default_run_limits_;
+    std::unordered_map<std::filesystem::path, RunLimits> run_limits_;
+    std::map<std::filesystem::path, KillStats> kill_stats_;
+
+    ModuleGraph module_graph_; // Require edges seen by every state
+
+    FileWatcher watcher_; // Last, so its thread stops before anything its handler touches goes away
 };
 
 
@@ -0,0 +1,67 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/ScriptRegistry.h
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/// ScriptRegistry
+/// - The set of loaded scripts as an immutable snapshot behind an atomic shared_ptr (RCU style).
+/// - Readers (run_script, pooled state syncs, the watcher) take a snapshot and keep using it for as long
+///   as they hold it, so an in-flight run finishes on the chunk it started with.
+/// - Taking a snapshot is not lock-free: libstdc++'s atomic<shared_ptr> guards the load with an internal
+///   spin bit for the length of a refcount increment. The steady-state check whether anything changed
+///   is generation(), a plain atomic load, so a pooled state only takes a snapshot after a publish.
+/// - Writers copy the current snapshot, edit the copy and swap it in; a mutex only orders writers.
+class ScriptRegistry {
+public:
+    struct Entry {
+        std::shared_ptr<const std::string> bytecode;
+        std::uint64_t source_hash = 0;
+        std::uint64_t version = 0; // Generation the entry was published in
+        std::filesystem::file_time_type last_write{}; // Modification time when the source was read
+    };
+
+    struct Snapshot {
+        std::unordered_map<std::filesystem::path, Entry> scripts;
+        std::uint64_t generation = 0; // Bumped by every publish so idle states can skip the sync scan
+    };
+
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+    // Edits a private copy of the snapshot, the edit stamps new entries with `generation`
+    using Edit = std::function<void(Snapshot& next, std::uint64_t generation)>;
+
+    ScriptRegistry() : current_(std::make_shared<const Snapshot>()) {}
+
+    ScriptRegistry(const ScriptRegistry&) = delete;
+    ScriptRegistry& operator=(const ScriptRegistry&) = delete;
+
+    [[nodiscard]] SnapshotPtr snapshot() const { return current_.load(std::memory_order_acquire); }
+
+    // Generation of the latest snapshot, lock-free. Bumped after the snapshot is swapped in.
+    [[nodiscard]] std::uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
+
+    [[nodiscard]] bool contains(const std::filesystem::path& path) const { return snapshot()->scripts.contains(path); }
+
+    // Adds or replaces one script and returns the new generation
+    std::uint64_t publish(const std::filesystem::path& path, Entry entry);
+
+    // Applies several changes under one copy and one swap, used for bulk restores and reloads
+    std::uint64_t update(const Edit& edit);
+
+    bool erase(const std::filesystem::path& path);
+
+private:
+    std::mutex writer_mutex_;
+    std::atomic<SnapshotPtr> current_;
+    std::atomic<std::uint64_t> generation_ = 0;
+};
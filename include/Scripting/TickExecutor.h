@@ -0,0 +1,116 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/TickExecutor.h
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Scripting/LuaStatePool.h"
+#include "Scripting/ScriptExecutor.h"
+
+/// TickExecutor
+/// - Runs scripts at fixed periods (a 100 Hz filter next to a 5 Hz planner) on one dedicated state and thread.
+/// - Releases are absolute: the thread sleeps with clock_nanosleep(TIMER_ABSTIME) for the last stretch before a
+///   release, so a late wakeup never drifts the phase of later ones. Further out it waits on a condition variable,
+///   so adding or removing a tick, posting an update or stopping wakes it straight away.
+/// - Released ticks run earliest-deadline-first (deadline = release + period) and are not preempted.
+/// - A tick that falls a whole period behind skips the releases it missed instead of running back to back.
+/// - Bindings and reloads are posted to the executor and applied between ticks, like CoroutineScheduler.
+class TickExecutor {
+public:
+    using TickId = std::uint64_t;
+    using Clock = std::chrono::steady_clock; // CLOCK_MONOTONIC on Linux, the clock clock_nanosleep waits on
+    using StateHook = LuaStatePool::StateHook;
+    // Runs one tick, overwriting the result the tick thread keeps so steady ticks reuse its buffers
+    using RunFn = std::function<void(LuaStatePool::PooledState&, const ScriptExecutor::JobRequest&, ScriptExecutor::JobResult&)>;
+
+    struct TickStats {
+        std::uint64_t runs = 0;
+        std::uint64_t failures = 0; // Runs that did not finish SUCCEEDED
+        std::uint64_t overruns = 0; // Runs that took longer than the period
+        std::uint64_t deadline_misses = 0; // Runs that finished after release + period
+        std::uint64_t skipped = 0; // Releases dropped because the tick was a full period behind
+        std::chrono::microseconds last_jitter{0}; // Start time minus release time
+        std::chrono::microseconds max_jitter{0};
+        std::chrono::microseconds total_jitter{0};
+        std::chrono::microseconds last_run_time{0};
+        std::chrono::microseconds max_run_time{0};
+        std::chrono::microseconds total_run_time{0};
+    };
+
+    struct TickInfo {
+        TickId id = 0;
+        std::filesystem::path path;
+        std::string entry; // Entry point called each tick with the seconds since its last start, empty runs the chunk
+        std::chrono::microseconds period{0};
+        TickStats stats;
+    };
+
+    TickExecutor() = default;
+    ~TickExecutor() { stop(); }
+
+    TickExecutor(const TickExecutor&) = delete;
+    TickExecutor& operator=(const TickExecutor&) = delete;
+
+    // Warms a dedicated state with `warm`, then starts the tick thread; `run` executes one tick on that state.
+    // A nonzero `realtime_priority` asks for SCHED_FIFO at that priority, failing that the thread stays normal.
+    void start(const StateHook& warm, RunFn run, bool size_class_allocator = false, int realtime_priority = 0);
+
+    // Stops the thread and drops every tick
+    void stop();
+
+    [[nodiscard]] bool running() const { return running_; }
+
+    // Runs `path` (or its `entry` function) every `period`, first release one period from now
+    std::expected<TickId, std::string> add(const std::filesystem::path& path, std::chrono::microseconds period,
+                                           const std::string& entry = {});
+
+    bool remove(TickId id);
+
+    // Applies `update` to the tick state before the next tick, no-op when stopped
+    void post(StateHook update);
+
+    [[nodiscard]] std::vector<TickInfo> ticks() const;
+
+private:
+    struct Tick {
+        TickInfo info;
+        // Built once in add(); each release only rewrites the dt argument. Shared so a run can use it outside the
+        // lock while remove() erases the tick.
+        std::shared_ptr<ScriptExecutor::JobRequest> request;
+        Clock::time_point next_release{};
+        Clock::time_point last_start{};
+    };
+
+    void run_loop();
+    void apply_pending();
+
+    // Sleeps until `until` on the absolute monotonic clock
+    static void sleep_until(Clock::time_point until);
+
+    std::unique_ptr<LuaStatePool::PooledState> state_; // Only touched by the tick thread once started
+    RunFn run_;
+    std::thread thread_;
+    std::atomic_bool running_ = false;
+    std::atomic_bool stop_requested_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_cv_; // Waited on while no release is close
+    std::uint64_t schedule_version_ = 0; // Bumped by add() and remove(), so a waiting loop rescans
+    std::map<TickId, Tick> ticks_;
+    std::vector<StateHook> pending_updates_;
+    TickId next_id_ = 1;
+};
@@ -0,0 +1,93 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/Scripting/ZygoteSupervisor.h
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Scripting/ScriptExecutor.h"
+
+class ScriptManager;
+
+/// ZygoteSupervisor
+/// - Zygote mode: an engine is set up once (init, plugins loaded, scripts compiled and installed in every
+///   pooled state), then a zygote process is forked from it. The zygote stays single-threaded and forks
+///   workers on request, so each worker shares its pages copy-on-write and starts warm.
+/// - Workers still get process isolation: one that crashes or is killed fails only the job it was running,
+///   and the supervisor asks the zygote for a replacement.
+/// - The supervisor lives in the original process: jobs are queued, handed to idle workers over a socket
+///   and their results returned as futures. POSIX only, start() fails elsewhere.
+class ZygoteSupervisor {
+public:
+    using JobRequest = ScriptExecutor::JobRequest;
+    using JobResult = ScriptExecutor::JobResult;
+
+    struct Stats {
+        std::uint64_t jobs = 0;
+        std::uint64_t failures = 0; // Jobs that did not succeed, including ones lost with their worker
+        std::uint64_t respawns = 0; // Workers replaced after dying
+        std::size_t workers = 0;
+    };
+
+    explicit ZygoteSupervisor(ScriptManager& scripts) : scripts_(scripts) {}
+    ~ZygoteSupervisor() { stop(); }
+
+    ZygoteSupervisor(const ZygoteSupervisor&) = delete;
+    ZygoteSupervisor& operator=(const ZygoteSupervisor&) = delete;
+
+    // Quiesces the manager, forks the zygote, resumes the manager and forks `worker_count` workers.
+    // Call once everything worth sharing is loaded, while no other thread in the process holds a lock
+    // the children could need (straight after startup is the intended point).
+    bool start(std::size_t worker_count);
+
+    // Lets in-flight jobs finish, fails queued ones, then closes the sockets so the zygote and workers exit
+    void stop();
+
+    [[nodiscard]] bool running() const { return running_; }
+
+    // Runs `request` in the next idle worker
+    std::future<JobResult> submit(JobRequest request);
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    struct Worker {
+        int pid = -1;
+        int fd = -1; // Supervisor end of the job socket
+        std::thread dispatcher;
+    };
+
+    struct PendingJob {
+        JobRequest request;
+        std::promise<JobResult> promise;
+    };
+
+    [[noreturn]] static void zygote_main(ScriptManager& scripts, int control_fd);
+    [[noreturn]] static void worker_main(ScriptManager& scripts, int job_fd);
+
+    // Asks the zygote for a new worker and stores its pid and socket in `worker`
+    bool spawn_worker(Worker& worker);
+    void dispatch_loop(Worker& worker);
+
+    ScriptManager& scripts_;
+    int zygote_pid_ = -1;
+    int control_fd_ = -1;
+    std::mutex control_mutex_; // One spawn request on the control socket at a time
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::deque<PendingJob> queue_;
+    bool stopping_ = false;
+    Stats stats_;
+    std::atomic_bool running_ = false;
+};
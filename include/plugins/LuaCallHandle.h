@@ -0,0 +1,135 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/plugins/LuaCallHandle.h
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "Scripting/ScriptManager.h"
+
+/// LuaCallHandle<R(Args...)>
+/// - Typed handle to a function exported by a Lua module, normally another plugin's plugin.lua.
+/// - Resolved once on the engine thread (require, lookup, type check) and cached as a protected function,
+///   so each call afterwards is a single protected call on the primary state.
+/// - Follows the module graph: once a reload invalidates the module, the next call resolves it again.
+/// - Copies share one cached function. Callable from any thread, the call itself runs on the engine thread.
+template<typename Signature>
+class LuaCallHandle;
+
+template<typename R, typename... Args>
+class LuaCallHandle<R(Args...)> {
+public:
+    using Result = std::expected<R, std::string>;
+
+    LuaCallHandle() = default;
+    LuaCallHandle(ScriptManager& sm, std::string module, std::string function)
+        : target_(std::make_shared<Target>(sm, std::move(module), std::move(function))) {}
+
+    [[nodiscard]] bool bound() const { return target_ != nullptr; }
+
+    // A missing module or function, a Lua error or an unconvertible return value comes back as the error
+    Result call(Args... args) const {
+        if (!target_) {
+            return std::unexpected(std::string("call handle is not bound"));
+        }
+        try {
+            return target_->sm->engine_call([target = target_.get(), &args...](sol::state& lua) {
+                return target->invoke(lua, args...);
+            }).get();
+        } catch (const std::exception& e) {
+            return std::unexpected(std::string(e.what()));
+        }
+    }
+
+    // Lookups done so far: 1 after the first call, plus one per reload of the module
+    [[nodiscard]] std::uint64_t resolve_count() const { return target_ ? target_->resolves.load() : 0; }
+
+private:
+    // Only touched on the engine thread, apart from the resolve counter
+    struct Target {
+        Target(ScriptManager& manager, std::string module_name, std::string function_name)
+            : sm(&manager), module(std::move(module_name)), name(std::move(function_name)) {}
+
+        ~Target() {
+            // The cached function is a reference into the primary state, so it is released on its thread
+            if (function.valid()) {
+                sm->engine_post([released = std::move(function)](sol::state&) mutable { released = sol::lua_nil; });
+            }
+        }
+
+        Target(const Target&) = delete;
+        Target& operator=(const Target&) = delete;
+
+        Result invoke(sol::state& lua, Args&... args) {
+            if (auto resolved = refresh(lua); !resolved) {
+                return std::unexpected(resolved.error());
+            }
+
+            sol::protected_function_result result = function(args...);
+            if (!result.valid()) {
+                const sol::error error = result;
+                return std::unexpected(module + "." + name + ": " + error.what());
+            }
+            if constexpr (std::is_void_v<R>) {
+                return {};
+            } else {
+                auto value = result.template get<sol::optional<R>>();
+                if (!value) {
+                    return std::unexpected(module + "." + name + " returned " +
+                                           sol::type_name(lua.lua_state(), result.get_type()) + ", not the declared type");
+                }
+                return std::move(*value);
+            }
+        }
+
+        std::expected<void, std::string> refresh(sol::state& lua) {
+            // Read before requiring, so an invalidation landing during the lookup is seen by the next call
+            const std::uint64_t epoch = sm->module_epoch();
+            if (function.valid() && epoch != synced_epoch) {
+                const std::vector<std::string> stale = sm->modules_invalidated_since(synced_epoch);
+                if (std::find(stale.begin(), stale.end(), module) != stale.end()) {
+                    function = sol::protected_function();
+                }
+            }
+            synced_epoch = epoch;
+            if (function.valid()) {
+                return {};
+            }
+
+            const sol::protected_function require_fn = lua["require"];
+            sol::protected_function_result loaded = require_fn(module);
+            if (!loaded.valid()) {
+                const sol::error error = loaded;
+                return std::unexpected("require '" + module + "' failed: " + error.what());
+            }
+            const sol::object exports = loaded;
+            if (!exports.is<sol::table>()) {
+                return std::unexpected("module '" + module + "' did not return a table");
+            }
+            const sol::object candidate = exports.as<sol::table>()[name];
+            if (!candidate.is<sol::function>()) {
+                return std::unexpected("module '" + module + "' has no function '" + name + "'");
+            }
+            function = candidate.as<sol::protected_function>();
+            resolves.fetch_add(1, std::memory_order_relaxed);
+            return {};
+        }
+
+        ScriptManager* sm;
+        std::string module;
+        std::string name;
+        sol::protected_function function;
+        std::uint64_t synced_epoch = 0;
+        std::atomic<std::uint64_t> resolves = 0;
+    };
+
+    std::shared_ptr<Target> target_;
+};
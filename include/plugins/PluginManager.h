@@ -7,9 +7,19 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <string>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include "Scripting/FileWatcher.h"
 #include "Scripting/ScriptManager.h"
+#include "plugins/LuaCallHandle.h"
+#include "plugins/PluginService.h"
+#include <mutex>
+#include <shared_mutex>
+#include <typeinfo>
+#include <unordered_map>
 #include <utility>
 #include <dynalo.hpp>
 
@@ -51,7 +61,8 @@ inline std::string getPlatformLibraryExtension() {
 ///   - plugin.lua: function math_plugin.add(a, b) return cpp_add(a, b) end
 /// 
 /// Plugin B (depends on A):
-///   - Wrapper: int dep_add(int a, int b) { return ctx.call_lua<int>("math_plugin.add", a, b); }
+///   - Handle:  auto add = ctx.lua_function<int(int, int)>("plugins.math_plugin.plugin", "add");
+///   - Wrapper: int dep_add(int a, int b) { return add.call(a, b).value_or(0); }
 ///   - Usage: int result = dep_add(5, 3);  // Calls through Lua to Plugin A
 
 class PluginManager
@@ -59,30 +70,178 @@ class PluginManager
 public:
 
 
+    /// Native service tables published by the plugins of one session, by plugin name
+    class ServiceRegistry {
+    public:
+        void publish(const std::string& plugin, const PluginServiceHeader* table) {
+            std::unique_lock lock(mutex_);
+            tables_[plugin] = table;
+        }
+
+        void withdraw(const std::string& plugin) {
+            std::unique_lock lock(mutex_);
+            tables_.erase(plugin);
+        }
+
+        [[nodiscard]] const PluginServiceHeader* find(const std::string& plugin) const {
+            std::shared_lock lock(mutex_);
+            auto it = tables_.find(plugin);
+            return it == tables_.end() ? nullptr : it->second;
+        }
+
+    private:
+        mutable std::shared_mutex mutex_;
+        std::unordered_map<std::string, const PluginServiceHeader*> tables_;
+    };
+
     /// Plugin context passed to plugin init/shutdown functions
     /// Provides controlled access to Lua binding and inter-plugin calls
+    /// - One context per plugin per session, kept alive from pluginLoad until after pluginShutdown.
+    /// - Plugins keep per-session state here (emplace_state) instead of in globals, so the same
+    ///   loaded library can serve several sessions in one process without them seeing each other.
     struct pluginContext {
 
 
 
     public:
         ScriptManager* sm_ = nullptr;
-        explicit pluginContext(ScriptManager& sm) : sm_(&sm) {}
+        std::string plugin_name;
+        std::vector<std::string> dependencies; // Names declared in metadata.json, the only services this plugin may use
+        explicit pluginContext(ScriptManager& sm, std::string name = {}, ServiceRegistry* services = nullptr,
+                               std::vector<std::string> dependency_names = {})
+            : sm_(&sm), plugin_name(std::move(name)), dependencies(std::move(dependency_names)), services_(services) {}
 
         /// Bind C++ function to global Lua namespace
         template<typename Func>
         void bind_function(const std::string& name, Func&& func) {
-            sm_->bind_function(name, std::forward<Func>(func));
+            if (recording_) {
+                recorded_.push_back([sm = sm_, owner = plugin_name, name, fn = std::decay_t<Func>(std::forward<Func>(func))] {
+                    sm->bind_function(name, fn, owner);
+                });
+                return;
+            }
+            sm_->bind_function(name, std::forward<Func>(func), plugin_name);
         }
 
         /// Bind C++ function to specific Lua namespace (recommended for plugins)
         template<typename Func>
         void bind_function_namespace(const std::string& ns, const std::string& name, Func&& func) {
             std::cout << "[pluginContext] Binding " << ns << "." << name << "\n";
-            sm_->bind_function_namespace(ns, name, std::forward<Func>(func));
+            if (recording_) {
+                recorded_.push_back([sm = sm_, owner = plugin_name, ns, name, fn = std::decay_t<Func>(std::forward<Func>(func))] {
+                    sm->bind_function_namespace(ns, name, fn, owner);
+                });
+                return;
+            }
+            sm_->bind_function_namespace(ns, name, std::forward<Func>(func), plugin_name);
+        }
+
+        /// While recording, bind_function calls are queued instead of applied. The parallel loader records during
+        /// pluginLoad and applies them on its own thread, in call order, once the plugin's level has loaded.
+        void record_bindings(const bool enabled) { recording_ = enabled; }
+
+        /// Applies and clears the queued bindings, returns how many there were
+        std::size_t apply_recorded_bindings() {
+            std::vector<std::function<void()>> recorded;
+            recorded.swap(recorded_);
+            for (auto& bind : recorded) {
+                bind();
+            }
+            return recorded.size();
+        }
+
+        /// Create this session's plugin state, replacing any previous one.
+        /// Bound lambdas should capture weak_state<T>() rather than the address: Lua code can keep a copy of a
+        /// bound function past unload or reload, and the weak handle lets that call fail instead of reading freed state.
+        template<typename T, typename... Args>
+        T& emplace_state(Args&&... args) {
+            auto state = std::make_shared<T>(std::forward<Args>(args)...);
+            T& ref = *state;
+            state_ = std::move(state);
+            return ref;
         }
 
+        /// This session's plugin state, nullptr before emplace_state. T must match the emplaced type.
+        template<typename T>
+        [[nodiscard]] T* state() const { return static_cast<T*>(state_.get()); }
 
+        /// Weak handle to this session's plugin state, expired once the loader drops it. T must match the emplaced type.
+        template<typename T>
+        [[nodiscard]] std::weak_ptr<T> weak_state() const { return std::static_pointer_cast<T>(state_); }
+
+        /// Typed handle to `function` in Lua module `module` (another plugin's plugin.lua), resolved on first call
+        /// and again after the module reloads. Keep it (e.g. in the plugin state) and call it as often as needed.
+        template<typename Signature>
+        [[nodiscard]] LuaCallHandle<Signature> lua_function(const std::string& module, const std::string& function) const {
+            return LuaCallHandle<Signature>(*sm_, module, function);
+        }
+
+        /// Calls "module.function", e.g. "plugins.test_plugin.plugin.cpp_add", through a handle this context
+        /// caches per name and signature, so only the first call looks the function up
+        template<typename R, typename... Args>
+        std::expected<R, std::string> call_lua(const std::string& qualified, Args&&... args) {
+            using Handle = LuaCallHandle<R(std::decay_t<Args>...)>;
+            const std::size_t dot = qualified.rfind('.');
+            if (dot == std::string::npos) {
+                return std::unexpected("call_lua needs module.function, got '" + qualified + "'");
+            }
+
+            std::shared_ptr<void> cached;
+            {
+                std::lock_guard lock(handles_mutex_);
+                std::shared_ptr<void>& slot = handles_[qualified + '\0' + typeid(Handle).name()];
+                if (!slot) {
+                    slot = std::make_shared<Handle>(*sm_, qualified.substr(0, dot), qualified.substr(dot + 1));
+                }
+                cached = slot;
+            }
+            return static_cast<Handle*>(cached.get())->call(std::forward<Args>(args)...);
+        }
+
+        /// Publishes this plugin's native service table under its metadata name, for dependents to call directly.
+        /// The table (usually a static const in the plugin) must stay valid until pluginShutdown returns.
+        bool publish_service(const PluginServiceHeader* table) {
+            if (!services_ || !table) {
+                return false;
+            }
+            services_->publish(plugin_name, table);
+            std::cout << "[pluginContext] " << plugin_name << " published service v" << table->version << "\n";
+            return true;
+        }
+
+        /// `dependency`'s native service table, or nullptr unless it is declared in this plugin's metadata.json and
+        /// published ABI `version` with a table at least sizeof(T) long. Dependencies load first, so ask in pluginLoad.
+        template<typename T>
+        [[nodiscard]] const T* service(const std::string& dependency, const std::uint32_t version) const {
+            static_assert(std::is_standard_layout_v<T>, "service tables are C structs starting with a PluginServiceHeader");
+            if (!services_) {
+                return nullptr;
+            }
+            if (std::find(dependencies.begin(), dependencies.end(), dependency) == dependencies.end()) {
+                std::cerr << "[pluginContext] " << plugin_name << " is not declared to depend on " << dependency << "\n";
+                return nullptr;
+            }
+            const PluginServiceHeader* header = services_->find(dependency);
+            if (!header || header->version != version || header->size < sizeof(T)) {
+                return nullptr;
+            }
+            return reinterpret_cast<const T*>(header);
+        }
+
+        /// Dropped on the engine thread after pluginShutdown, so Lua references it holds are released there
+        void reset_state() {
+            state_.reset();
+            std::lock_guard lock(handles_mutex_);
+            handles_.clear();
+        }
+
+    private:
+        bool recording_ = false;
+        std::vector<std::function<void()>> recorded_;
+        ServiceRegistry* services_ = nullptr;
+        std::shared_ptr<void> state_;
+        std::mutex handles_mutex_;
+        std::unordered_map<std::string, std::shared_ptr<void>> handles_; // call_lua handles by name and signature
     };
     /// Required API functions that every plugin must implement
     struct RequiredPluginAPI {
@@ -106,7 +265,8 @@ public:
         fs::path folder_path;
         fs::path lib_path;
         fs::path luaScript_path;  // plugin.lua header file
-        std::optional<dynalo::library> lib;
+        std::shared_ptr<dynalo::library> lib; // Shared with every session that loaded the same file
+        std::unique_ptr<pluginContext> context; // This session's context, after lib so it is destroyed first
         RequiredPluginAPI RequiredAPI;
 
 
@@ -118,160 +278,137 @@ public:
               version(""),
               folder_path(folder),
               lib_path(""),
-              luaScript_path(""),
-              lib(std::nullopt) // 👈 initialize dynalo::library (empty handle)
+              luaScript_path("")
         {}
     };
 
 
 
 
-    void loadPluginsFromDir(const fs::path& plugin_dir, ScriptManager& sm) const
-    {
-        if (!fs::exists(plugin_dir) || !fs::is_directory(plugin_dir)) {
-            std::cerr << "[PluginLoader] Plugin directory not found: " << plugin_dir << "\n";
-            return;
-        }
+    /// Library hot reload counters for this session
+    struct LibraryReloadStats {
+        std::uint64_t reloads = 0; // Reload passes that ran, one per debounced rebuild
+        std::uint64_t failures = 0; // Libraries that would not open, plus plugins whose pluginLoad failed again
+        std::uint64_t restarted = 0; // Plugins shut down and loaded again, dependents included
+        double last_reload_ms = 0.0; // First shutdown to last pluginLoad of the latest pass
+    };
 
-        for (const auto& entry : fs::directory_iterator(plugin_dir)) {
-            if (!entry.is_directory())
-                continue;
 
-            const fs::path& folder = entry.path();
-            try {
-                loadPluginMetadata(folder);
-                std::cout << "[PluginLoader] Loaded plugin from " << folder << "\n";
-            } catch (const std::exception& e) {
-                std::cerr << "[PluginLoader] Failed to load plugin in " << folder << ": " << e.what() << "\n";
-            }
+    PluginManager() = default;
+    ~PluginManager() { unloadPlugins(); }
 
-        }
-        if (auto loadOrder = ResolveLoadOrder()) {
-            std::cout << "[PluginLoader] Load order resolved, found " << loadOrder->size() << " plugins\n";
-
-            for (plugin& entry : *loadOrder) {
-                std::cout << "[PluginLoader] Loading: " << entry.name << "\n";
-                
-                // Debug: Check test_plugin namespace before loading math_consumer
-                if (entry.name == "math_consumer") {
-                    try {
-                        sol::table test_ns = sm.sol_state()["test_plugin"];
-                        if (test_ns.valid()) {
-                            sol::function cpp_add = test_ns["cpp_add"];
-                            std::cout << "[DEBUG] Before math_consumer load - test_plugin.cpp_add valid: " << (cpp_add.valid() ? "YES" : "NO") << "\n";
-                            if (cpp_add.valid()) {
-                                int result = cpp_add(10, 20);
-                                std::cout << "[DEBUG] test_plugin.cpp_add(10, 20) = " << result << "\n";
-                            }
-                        } else {
-                            std::cout << "[DEBUG] test_plugin namespace is INVALID\n";
-                        }
-                    } catch (const std::exception& e) {
-                        std::cerr << "[DEBUG] Exception checking namespace: " << e.what() << "\n";
-                    }
-                }
-                
-                if (loadPluginLibrary(entry, sm)) {
-                    // plugin.lua files are loaded via require() in scripts, not directly executed
-                    if (fs::exists(entry.luaScript_path)) {
-                        std::cout << "[PluginLoader] Plugin Lua header available: " << entry.luaScript_path << "\n";
-                    }
-                    entry.loaded = true;
-                    std::cout << "[PluginLoader] Successfully loaded: " << entry.name << "\n";
-                } else {
-                    std::cerr << "[PluginLoader] Failed to load: " << entry.name << "\n";
-                }
-            }
-        } else {
-            std::cerr << "[PluginLoader] Failed to resolve plugin load order: " << loadOrder.error() << "\n";
-        }
+    PluginManager(const PluginManager&) = delete;
+    PluginManager& operator=(const PluginManager&) = delete;
 
-    }
+    /// Loads every plugin under `plugin_dir` one dependency level at a time. Within a level, metadata parsing,
+    /// dlopen, symbol lookup and pluginLoad run in parallel; the Lua bindings each plugin makes are recorded and
+    /// applied on this thread once its level is done, so startup scales with the depth of the dependency tree.
+    void loadPluginsFromDir(const fs::path& plugin_dir, ScriptManager& sm) const;
 
 
     [[nodiscard]] bool CheckIfPluginExists(const std::string& name) const
     {
-        if (!loadedPlugins) {
-            // Handle error or just return false
-            return false;
-        }
-
-        for (const plugin& ExistingPlugin : *loadedPlugins) {
-            if (ExistingPlugin.name == name)
-                return true;
-        }
-        return false;
-
+        return pluginIndex->contains(name);
     }
     bool loadPluginMetadata(const std::filesystem::path& pluginDir) const;
-    static bool loadPluginLibrary(const plugin& newPlugin, ScriptManager& sm);
+    /// Reads one plugin folder (library, plugin.lua, metadata.json) without registering it, safe to run in parallel
+    static std::optional<plugin> parsePluginMetadata(const std::filesystem::path& pluginDir);
+    /// With `record_bindings`, bindings made in pluginLoad are held in the context until apply_recorded_bindings()
+    bool loadPluginLibrary(plugin& newPlugin, ScriptManager& sm, bool record_bindings = false) const;
+
+    /// Native services published so far in this session
+    [[nodiscard]] const ServiceRegistry& services() const { return *services_; }
+
+    /// Calls pluginShutdown for every loaded plugin in reverse load order, withdraws its service, drops its bindings
+    /// and its context. Stops hot reload first. Must run while the ScriptManager the plugins were loaded into is still alive.
+    void unloadPlugins() const;
+
+    /// Restarts `name` on the library now at its lib_path, along with every plugin that depends on it, directly or not.
+    /// pluginShutdown runs dependents first, their bindings are dropped, then pluginLoad runs again in load order and
+    /// binds afresh. Scripts already running are left alone: pooled states are only rebound once they are idle.
+    /// If the new library does not open, the running version stays loaded. Returns false if anything failed.
+    bool reloadPlugin(const std::string& name, ScriptManager& sm) const;
+
+    /// Watches the lib_path of every plugin loaded so far and reloads the ones rebuilt, one pass per debounced batch.
+    /// The debounce should outlast the linker writing the file.
+    void startHotReload(ScriptManager& sm, std::chrono::milliseconds debounce = std::chrono::milliseconds(250)) const;
+    void stopHotReload() const;
+    [[nodiscard]] LibraryReloadStats hotReloadStats() const;
+
+    /// Process-wide handle for a plugin library; every session loading the same build shares one handle.
+    /// The library is opened from a private copy, so a rebuild can overwrite lib_path while it is in use, and the
+    /// first acquire after lib_path changes opens the new build. Replaced builds stay mapped for the life of the
+    /// process, since Lua states and other sessions may still hold functions from them.
+    static std::shared_ptr<dynalo::library> acquireLibrary(const fs::path& lib_path);
 
     [[nodiscard]]
     std::expected<std::reference_wrapper<plugin>, bool> GetPluginByName(const std::string& name) const
     {
-        for (plugin& ExistingPlugin : *loadedPlugins)
-        {
-            if (ExistingPlugin.name == name)
-                return std::ref(ExistingPlugin); // wrap the reference
+        auto found = pluginIndex->find(name);
+        if (found == pluginIndex->end()) {
+            return std::unexpected(false);
         }
-        return std::unexpected(false); // return an error value
-    }
-    static bool contains_plugin_with_name(const std::vector<std::reference_wrapper<plugin>>& plugins, const std::string& target) {
-        return std::any_of(plugins.begin(), plugins.end(),
-                           [&](const std::reference_wrapper<plugin>& p_ref) {
-                               return p_ref.get().name == target;
-                           });
+        return std::ref((*loadedPlugins)[found->second]);
     }
+
+    /// Kahn's algorithm over the registered plugins, O(plugins + dependencies). Plugins with no order between
+    /// them keep their registration order. A missing dependency or a cycle is an error naming the plugins involved,
+    /// for a cycle the full path, e.g. "a -> b -> c -> a".
     [[nodiscard]]
     std::expected<std::vector<std::reference_wrapper<plugin>>, std::string>
-    ResolveLoadOrder() const
+    ResolveLoadOrder() const;
+
+    /// Load order grouped into levels: a plugin's dependencies are all in earlier levels, so each level can load in parallel
+    [[nodiscard]]
+    std::expected<std::vector<std::vector<std::reference_wrapper<plugin>>>, std::string>
+    ResolveLoadLevels() const
     {
-        if (!loadedPlugins) { return std::unexpected("loaded plugins does not exist.");}
-        std::vector<std::reference_wrapper<plugin>> PluginLoadOrder;
-        size_t lastSize = 0;
-        
-        while (loadedPlugins->size() != PluginLoadOrder.size())
-        {
-            bool progressMade = false;
-            for (plugin& PluginMetadata : *loadedPlugins)
-            {
-                if (contains_plugin_with_name(PluginLoadOrder, PluginMetadata.name)) { continue; }
-                
-                if (!PluginMetadata.dependencies.is_array())
-                {
-                    std::cerr << "[PluginLoader] Dependencies format not supported for " << PluginMetadata.name << "\n";
-                    continue;
-                }
-                
-                bool allDepsResolved = true;
-                for (const json& dep : PluginMetadata.dependencies)
-                {
-                    if (!dep.is_object()) continue;
-                    std::string depName = dep.value("name", std::string());
-                    if (!contains_plugin_with_name(PluginLoadOrder, depName))
-                    {
-                        allDepsResolved = false;
-                        break;
-                    }
-                }
-                
-                if (allDepsResolved)
-                {
-                    PluginLoadOrder.emplace_back(PluginMetadata);
-                    std::cout << "[PluginLoader] Added to load order: " << PluginMetadata.name << "\n";
-                    progressMade = true;
+        auto order = ResolveLoadOrder();
+        if (!order) {
+            return std::unexpected(order.error());
+        }
+
+        std::unordered_map<std::string, std::size_t> levelOf;
+        std::vector<std::vector<std::reference_wrapper<plugin>>> levels;
+        for (plugin& entry : *order) {
+            std::size_t level = 0;
+            for (const json& dep : entry.dependencies) {
+                if (!dep.is_object()) continue;
+                if (auto found = levelOf.find(dep.value("name", std::string())); found != levelOf.end()) {
+                    level = std::max(level, found->second + 1);
                 }
             }
-            
-            if (!progressMade) {
-                return std::unexpected("Circular dependency or missing dependency detected");
+            levelOf[entry.name] = level;
+            if (levels.size() <= level) {
+                levels.resize(level + 1);
             }
+            levels[level].emplace_back(entry);
         }
-        return PluginLoadOrder;
+        return levels;
     }
 
-
 private:
+    // Appends to loadedPlugins and indexes it by name
+    void registerPlugin(plugin&& newPlugin) const;
+
+    // pluginShutdown on the engine thread, then withdraws the plugin's service and bindings and drops its context
+    void shutdownPlugin(plugin& entry) const;
+
+    // One reload pass over several rebuilt plugins, restarting the union of their dependents once
+    bool reloadPlugins(const std::vector<std::string>& names, ScriptManager& sm) const;
+
+    struct HotReload {
+        std::mutex mutex; // Held for a whole reload pass, and by unloadPlugins
+        FileWatcher watcher;
+        mutable std::mutex stats_mutex;
+        LibraryReloadStats stats;
+    };
+
     using pluginVector = std::vector<plugin>;
     std::unique_ptr<pluginVector> loadedPlugins = std::make_unique<pluginVector>();
+    std::unique_ptr<std::unordered_map<std::string, std::size_t>> pluginIndex =
+        std::make_unique<std::unordered_map<std::string, std::size_t>>(); // name -> position in loadedPlugins
+    std::unique_ptr<std::vector<std::string>> loadOrder_ = std::make_unique<std::vector<std::string>>();
+    std::unique_ptr<ServiceRegistry> services_ = std::make_unique<ServiceRegistry>();
+    std::unique_ptr<HotReload> hotReload_ = std::make_unique<HotReload>();
 };
\ No newline at end of file
@@ -0,0 +1,26 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /include/plugins/PluginService.h
+
+#pragma once
+
+#include <stdint.h>
+
+/// PluginServiceHeader
+/// - First member of every native service table a plugin publishes through pluginContext::publish_service.
+/// - Tables are plain C structs of function pointers, so no C++ type crosses the plugin boundary.
+/// - `version` is the table's ABI version, bumped on any incompatible change; consumers need an exact match.
+/// - `size` is sizeof the published table: functions appended later stay invisible to older consumers,
+///   and a newer consumer can tell when an older table is too short for it.
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct PluginServiceHeader {
+    uint32_t version;
+    uint32_t size;
+} PluginServiceHeader;
+
+#ifdef __cplusplus
+}
+#endif
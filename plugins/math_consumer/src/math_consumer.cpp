@@ -2,12 +2,15 @@
 /// 
 /// This plugin shows how to:
 /// 1. Depend on another plugin (test_plugin)
-/// 2. Create C++ wrapper functions that call dependency functions via Lua
+/// 2. Call dependency functions directly through its native service, falling back to its Lua module
 /// 3. Expose higher-level functionality built on dependencies
 
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include "plugins/PluginManager.h"
 #include "Scripting/ScriptManager.h"
+#include "test_plugin/TestPluginService.h"
 
 #ifdef _WIN32
 #define PLUGIN_EXPORT __declspec(dllexport)
@@ -15,76 +18,60 @@
 #define PLUGIN_EXPORT __attribute__((visibility("default")))
 #endif
 
-// Global ScriptManager pointer for dependency calls
-static ScriptManager* g_sm = nullptr;
-static sol::table test_plugin;
-
-// Dependency wrapper functions - call test_plugin via Lua
-int dependency_add(int a, int b) {
-    if (!g_sm) return 0;
-
-    sol::state_view& lua = g_sm->sol_state();
-    sol::function require_fn = lua["require"];
-    sol::table mod = require_fn("plugins.test_plugin.plugin");
-    if (!mod.valid()) {
-        std::cerr << "[math_consumer] ERROR: test_plugin module invalid\n";
-        return 0;
+// Per-session state, kept in the pluginContext so each session that loads this plugin gets its own
+struct ConsumerSession {
+    // test_plugin's native table: direct calls, no Lua in between. Null if it did not publish a compatible one.
+    const TestPluginService* native = nullptr;
+    // Fallback: typed handles into test_plugin's module, looked up once and again only if the module reloads
+    LuaCallHandle<int(int, int)> add;
+    LuaCallHandle<int(int, int)> multiply;
+};
+
+// Bound functions hold the session weakly. Lua may keep a copy of one past unload or reload, and calling it then
+// raises an error instead of touching the freed session. The lock keeps the session alive for the whole call.
+static std::shared_ptr<ConsumerSession> lock_session(const std::weak_ptr<ConsumerSession>& session) {
+    auto locked = session.lock();
+    if (!locked) {
+        throw std::runtime_error("math_consumer has been unloaded");
     }
+    return locked;
+}
 
-    const sol::object obj = mod["cpp_add"];
-    if (!obj.is<sol::function>()) {
-        std::cerr << "[math_consumer] ERROR: cpp_add is not a function\n";
+// Dependency wrapper functions - call test_plugin through its Lua module
+static int call_test_plugin(const LuaCallHandle<int(int, int)>& fn, int a, int b) {
+    auto result = fn.call(a, b);
+    if (!result) {
+        std::cerr << "[math_consumer] ERROR: " << result.error() << "\n";
         return 0;
     }
+    return *result;
+}
 
-    const sol::function fn = obj.as<sol::function>();
-
-    try {
-        return fn(a, b);
-    } catch (const std::exception& e) {
-        std::cerr << "[math_consumer] Exception calling cpp_add: " << e.what() << "\n";
-        return 0;
+int dependency_add(ConsumerSession& session, int a, int b) {
+    if (session.native) {
+        return session.native->add(a, b);
     }
+    return call_test_plugin(session.add, a, b);
 }
 
-int dependency_multiply(int a, int b) {
+int dependency_multiply(ConsumerSession& session, int a, int b) {
     std::cout << "[math_consumer] Dependency_multiply called..." << std::endl;
-    if (!g_sm) return 0;
-
-    sol::state_view& lua = g_sm->sol_state();
-    sol::function require_fn = lua["require"];
-    sol::table mod = require_fn("plugins.test_plugin.plugin");
-    if (!mod.valid()) {
-        std::cerr << "[math_consumer] ERROR: test_plugin module invalid\n";
-        return 0;
-    }
-
-    const sol::object obj = mod["cpp_multiply"];
-    if (!obj.is<sol::function>()) {
-        std::cerr << "[math_consumer] ERROR: cpp_multiply is not a function\n";
-        return 0;
-    }
-
-    const sol::function fn = obj.as<sol::function>();
-
-    try {
-        return fn(a, b);
-    } catch (const std::exception& e) {
-        std::cerr << "[math_consumer] Exception calling cpp_multiply: " << e.what() << "\n";
-        return 0;
+    if (session.native) {
+        return session.native->multiply(a, b);
     }
+    return call_test_plugin(session.multiply, a, b);
 }
 // This plugin's own C++ functions
-int cpp_power_of_two(int base) {
+int cpp_power_of_two(ConsumerSession& session, int base) {
     std::cout << "[math_consumer] Computing " << base << "^2 using dependency functions\n";
-    return dependency_multiply(base, base);
+    return dependency_multiply(session, base, base);
 }
 
-int cpp_sum_of_squares(int a, int b) {
+int cpp_sum_of_squares(ConsumerSession& session, int a, int b) {
     std::cout << "[math_consumer] Computing " << a << "^2 + " << b << "^2\n";
-    int a_squared = dependency_multiply(a, a);
-    int b_squared = dependency_multiply(b, b);
-    return dependency_add(a_squared, b_squared);
+    int a_squared = dependency_multiply(session, a, a);
+    int b_squared = dependency_multiply(session, b, b);
+    return dependency_add(session, a_squared, b_squared);
 }
 
 extern "C" {
@@ -92,27 +79,41 @@ extern "C" {
     PLUGIN_EXPORT bool pluginLoad(PluginManager::pluginContext& ctx) {
         std::cout << "[math_consumer] Loading plugin with test_plugin dependency...\n";
         
-        // Store ScriptManager for dependency calls
-        g_sm = ctx.sm_;
-
-        std::string current_path = ctx.sm_->sol_state()["package"]["path"];
-        std::string plugin_path = "./?.lua;";
-
-        if (current_path.find(plugin_path) == std::string::npos) {
-            ctx.sm_->sol_state()["package"]["path"] = plugin_path + current_path;
-        }
-
-        // Require the Lua module
-        test_plugin = ctx.sm_->sol_state()["require"]("plugins.test_plugin.plugin");
-        if (!test_plugin.valid()) {
+        // Everything this plugin remembers lives in the session's context, not in globals
+        ConsumerSession& session = ctx.emplace_state<ConsumerSession>();
+        session.add = ctx.lua_function<int(int, int)>("plugins.test_plugin.plugin", "cpp_add");
+        session.multiply = ctx.lua_function<int(int, int)>("plugins.test_plugin.plugin", "cpp_multiply");
+        session.native = ctx.service<TestPluginService>("test_plugin", TEST_PLUGIN_SERVICE_VERSION);
+        std::cout << "[math_consumer] test_plugin native service: " << (session.native ? "yes" : "no, calling through Lua") << "\n";
+
+        // The primary state belongs to the engine thread, so the setup runs there
+        const bool required = ctx.sm_->engine_call([](sol::state& lua) {
+            std::string current_path = lua["package"]["path"];
+            std::string plugin_path = "./?.lua;";
+
+            if (current_path.find(plugin_path) == std::string::npos) {
+                lua["package"]["path"] = plugin_path + current_path;
+            }
+
+            // Require the Lua module up front so a missing dependency fails the load, not the first call
+            const sol::protected_function require_fn = lua["require"];
+            const sol::protected_function_result loaded = require_fn("plugins.test_plugin.plugin");
+            return loaded.valid() && loaded.get_type() == sol::type::table;
+        }).get();
+        if (!required) {
             std::cerr << "[math_consumer] Failed to load test_plugin module\n";
             return false;
         }
 
         
         // Bind this plugin's functions to Lua namespace
-        ctx.bind_function_namespace("math_consumer", "power_of_two", &cpp_power_of_two);
-        ctx.bind_function_namespace("math_consumer", "sum_of_squares", &cpp_sum_of_squares);
+        std::weak_ptr<ConsumerSession> bound = ctx.weak_state<ConsumerSession>();
+        ctx.bind_function_namespace("math_consumer", "power_of_two", [bound](int base) {
+            return cpp_power_of_two(*lock_session(bound), base);
+        });
+        ctx.bind_function_namespace("math_consumer", "sum_of_squares", [bound](int a, int b) {
+            return cpp_sum_of_squares(*lock_session(bound), a, b);
+        });
         
         std::cout << "[math_consumer] Plugin loaded successfully\n";
         //std::cout << dependency_multiply(2, 5) << std::endl;
@@ -122,7 +123,7 @@ extern "C" {
     /// Plugin cleanup
     PLUGIN_EXPORT bool pluginShutdown(PluginManager::pluginContext& ctx) {
         std::cout << "[math_consumer] Shutting down plugin...\n";
-        g_sm = nullptr;
+        // The call handles go with the session state, which the loader drops on the engine thread
         return true;
     }
 }
\ No newline at end of file
@@ -0,0 +1,26 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /plugins/test_plugin/include/test_plugin/TestPluginService.h
+
+#pragma once
+
+#include "plugins/PluginService.h"
+
+/// TestPluginService
+/// - test_plugin's native service table, published under "test_plugin" for plugins that declare it as a dependency.
+/// - Direct C++ calls for hot paths; scripts keep using the Lua module in plugin.lua.
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TEST_PLUGIN_SERVICE_VERSION 1u
+
+typedef struct TestPluginService {
+    PluginServiceHeader header;
+    int (*add)(int a, int b);
+    int (*multiply)(int a, int b);
+} TestPluginService;
+
+#ifdef __cplusplus
+}
+#endif
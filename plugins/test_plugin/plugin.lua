@@ -13,6 +13,11 @@ function Module.multiply(a, b)
     return test_plugin.cpp_multiply(a, b)
 end
 
+-- Frame buffer of 1, 4, 9, ... valid until the current run ends, close it early with <close>
+function Module.squares(n)
+    return test_plugin.cpp_squares(n)
+end
+
 -- Direct access to C++ functions
 function Module.cpp_add(a, b)
     return test_plugin.cpp_add(a, b)
@@ -6,8 +6,12 @@
 /// 2. Exposes public API through plugin.lua header
 /// 3. Shows how to create dependency wrapper functions
 
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 #include "plugins/PluginManager.h"
+#include "Scripting/FrameArena.h"
+#include "test_plugin/TestPluginService.h"
 
 #ifdef _WIN32
 #define PLUGIN_EXPORT __declspec(dllexport)
@@ -26,9 +30,30 @@ int cpp_multiply_two_numbers(int a, int b) {
     return a * b; 
 }
 
+// Frame-scoped result: lives in the running state's arena, no userdata for the GC to chase
+FrameBuffer cpp_squares(int count) {
+    FrameArena* frame = FrameArena::current();
+    if (!frame) {
+        throw std::runtime_error("test_plugin.cpp_squares needs a running script");
+    }
+    FrameBuffer squares = frame->lease_buffer(static_cast<std::size_t>(std::max(count, 1)));
+    double* data = squares.data();
+    for (std::size_t i = 0; i < squares.size(); ++i) {
+        data[i] = static_cast<double>((i + 1) * (i + 1));
+    }
+    return squares;
+}
+
+// Native service for dependents that call from C++, same functions without the Lua round trip
+static const TestPluginService native_service = {
+    {TEST_PLUGIN_SERVICE_VERSION, sizeof(TestPluginService)},
+    &cpp_add_two_numbers,
+    &cpp_multiply_two_numbers,
+};
+
 // Example dependency wrapper function (if this plugin had dependencies)
 // int dependency_some_function(int x) {
-//     return ctx.call_lua<int>("other_plugin.some_function", x);
+//     return ctx.call_lua<int>("plugins.other_plugin.plugin.some_function", x).value_or(0);
 // }
 
 extern "C" {
@@ -41,9 +66,14 @@ extern "C" {
         ctx.bind_function_namespace("test_plugin", "cpp_add", &cpp_add_two_numbers);
         std::cout << "[test_plugin] Binding test_plugin.cpp_multiply\n";
         ctx.bind_function_namespace("test_plugin", "cpp_multiply", &cpp_multiply_two_numbers);
+        std::cout << "[test_plugin] Binding test_plugin.cpp_squares\n";
+        ctx.bind_function_namespace("test_plugin", "cpp_squares", &cpp_squares);
         
         // Also bind to global namespace for backward compatibility
         ctx.bind_function("cpp_add_two_numbers", &cpp_add_two_numbers);
+
+        // Dependents declaring test_plugin in their metadata.json can call these directly
+        ctx.publish_service(&native_service.header);
         
         std::cout << "[test_plugin] Functions bound to Lua successfully\n";
         return true; // Success
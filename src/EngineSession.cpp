@@ -0,0 +1,30 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/EngineSession.cpp
+#include "EngineSession.h"
+
+#include <iostream>
+
+EngineSession::~EngineSession()
+{
+    // Nothing may run plugin bindings while their state goes away, but the engine thread stays up so the plugins
+    // can still shut down through it
+    scripts_.stop_workers();
+    plugins_.unloadPlugins();
+}
+
+ScriptManager::SMInitResult EngineSession::init(const std::size_t pool_size)
+{
+    std::cout << "[EngineSession] Starting " << name_ << "\n";
+    return scripts_.init(pool_size);
+}
+
+void EngineSession::load_plugins(const std::filesystem::path& plugin_dir)
+{
+    plugins_.loadPluginsFromDir(plugin_dir, scripts_);
+}
+
+void EngineSession::start_plugin_hot_reload(const std::chrono::milliseconds debounce)
+{
+    plugins_.startHotReload(scripts_, debounce);
+}
@@ -0,0 +1,195 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/BytecodeCache.cpp
+#include "Scripting/BytecodeCache.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <lua.hpp>
+
+namespace fs = std::filesystem;
+
+// Bytecode is only portable between identical Lua builds, so the release and numeric layout go into the key
+static std::uint64_t version_fingerprint()
+{
+    std::ostringstream build;
+    build << LUA_RELEASE << '|' << sizeof(lua_Integer) << '|' << sizeof(lua_Number) << '|' << sizeof(void*);
+    return BytecodeCache::hash_content(build.str());
+}
+
+static int string_writer(lua_State*, const void* data, const size_t size, void* userdata)
+{
+    static_cast<std::string*>(userdata)->append(static_cast<const char*>(data), size);
+    return 0;
+}
+
+BytecodeCache::BytecodeCache(fs::path cache_dir)
+    : cache_dir_(std::move(cache_dir)),
+      scratch_(luaL_newstate())
+{
+}
+
+BytecodeCache::~BytecodeCache()
+{
+    if (scratch_) {
+        lua_close(scratch_);
+    }
+}
+
+// FNV-1a, 64 bit
+std::uint64_t BytecodeCache::hash_content(const std::string_view content)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (const char c : content) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::expected<std::string, std::string> BytecodeCache::read_file(const fs::path& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return std::unexpected("cannot open " + path.string());
+    }
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+fs::path BytecodeCache::dir_for(const fs::path& path) const
+{
+    fs::path dir;
+    {
+        std::lock_guard lock(dir_mutex_);
+        dir = cache_dir_;
+    }
+    if (dir.empty() || dir.is_absolute()) {
+        return dir;
+    }
+    std::error_code ec;
+    const fs::path script = fs::absolute(path, ec);
+    return (ec ? path : script).parent_path() / dir;
+}
+
+fs::path BytecodeCache::entry_path(const fs::path& dir, const std::uint64_t source_hash, const std::string_view chunk_name)
+{
+    static const std::uint64_t fingerprint = version_fingerprint();
+    std::ostringstream name;
+    name << std::hex << std::setfill('0')
+         << std::setw(16) << source_hash << '-'
+         << std::setw(8) << (hash_content(chunk_name) & 0xffffffffull) << '-'
+         << std::setw(8) << (fingerprint & 0xffffffffull) << ".luac";
+    return dir / name.str();
+}
+
+std::expected<BytecodeCache::CompiledChunk, std::string> BytecodeCache::fetch(const fs::path& path)
+{
+    std::lock_guard lock(scratch_mutex_);
+    return fetch(path, scratch_);
+}
+
+std::expected<BytecodeCache::CompiledChunk, std::string> BytecodeCache::fetch(const fs::path& path, lua_State* scratch)
+{
+    auto source = read_file(path);
+    if (!source) {
+        return std::unexpected(source.error());
+    }
+    const std::uint64_t source_hash = hash_content(*source);
+
+    // Hash matches a cached entry: skip the parser entirely
+    const fs::path dir = dir_for(path);
+    if (!dir.empty()) {
+        const fs::path entry = entry_path(dir, source_hash, chunk_name_for(path));
+        std::error_code ec;
+        if (fs::exists(entry, ec)) {
+            auto cached = read_file(entry);
+
+            // Undumping is cheap compared to parsing, and catches truncated or foreign entries
+            const bool usable = cached && !cached->empty()
+                && luaL_loadbufferx(scratch, cached->data(), cached->size(), "=cache", "b") == LUA_OK;
+            lua_settop(scratch, 0);
+
+            if (usable) {
+                ++hits_;
+                CompiledChunk chunk;
+                chunk.source_hash = source_hash;
+                chunk.bytecode = std::make_shared<const std::string>(std::move(*cached));
+                chunk.from_cache = true;
+                return chunk;
+            }
+            std::cerr << "[BytecodeCache] Discarding unreadable cache entry for " << path << "\n";
+            fs::remove(entry, ec);
+        }
+    }
+
+    return compile(*source, chunk_name_for(path), source_hash, scratch, dir);
+}
+
+std::expected<BytecodeCache::CompiledChunk, std::string>
+BytecodeCache::compile(const std::string_view source, const std::string_view chunk_name, const std::uint64_t source_hash,
+                       lua_State* scratch, const fs::path& dir)
+{
+    ++misses_;
+    std::string bytecode;
+    const std::string name(chunk_name);
+    if (luaL_loadbufferx(scratch, source.data(), source.size(), name.c_str(), "t") != LUA_OK) {
+        std::string error = lua_tostring(scratch, -1);
+        lua_pop(scratch, 1);
+        return std::unexpected(error);
+    }
+    lua_dump(scratch, &string_writer, &bytecode, 0); // keep debug info so tracebacks still show lines
+    lua_pop(scratch, 1);
+
+    if (!dir.empty()) {
+        // Write to a temp file and rename so a crash never leaves a half-written entry behind
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+        const fs::path entry = entry_path(dir, source_hash, chunk_name);
+        fs::path temp = entry;
+        temp += ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())); // unique per compiling thread
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            if (out.is_open()) {
+                out.write(bytecode.data(), static_cast<std::streamsize>(bytecode.size()));
+            }
+        }
+        fs::rename(temp, entry, ec);
+        if (ec) {
+            std::cerr << "[BytecodeCache] Could not write cache entry " << entry << ": " << ec.message() << "\n";
+            fs::remove(temp, ec);
+        }
+    }
+
+    CompiledChunk chunk;
+    chunk.source_hash = source_hash;
+    chunk.bytecode = std::make_shared<const std::string>(std::move(bytecode));
+    return chunk;
+}
+
+void BytecodeCache::invalidate(const fs::path& path, const std::uint64_t source_hash)
+{
+    const fs::path dir = dir_for(path);
+    if (dir.empty()) {
+        return;
+    }
+    std::error_code ec;
+    fs::remove(entry_path(dir, source_hash, chunk_name_for(path)), ec);
+}
+
+void BytecodeCache::set_cache_dir(const fs::path& cache_dir)
+{
+    std::lock_guard lock(dir_mutex_);
+    cache_dir_ = cache_dir;
+}
+
+fs::path BytecodeCache::cache_dir() const
+{
+    std::lock_guard lock(dir_mutex_);
+    return cache_dir_;
+}
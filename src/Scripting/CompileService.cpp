@@ -0,0 +1,159 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/CompileService.cpp
+#include "Scripting/CompileService.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <lua.hpp>
+
+void CompileService::start(std::size_t worker_count)
+{
+    if (worker_count == 0) {
+        worker_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    {
+        std::lock_guard lock(mutex_);
+        if (running_ && workers_.size() == worker_count) {
+            return;
+        }
+        running_ = true; // Submissions keep queueing while the workers are replaced
+    }
+    join_workers();
+
+    std::lock_guard lock(mutex_);
+    stopping_ = false;
+    for (std::size_t i = 0; i < worker_count; ++i) {
+        workers_.emplace_back([this] { worker_loop(); });
+    }
+    std::cout << "[CompileService] Workers: " << worker_count << "\n";
+}
+
+void CompileService::stop()
+{
+    {
+        std::lock_guard lock(mutex_);
+        running_ = false;
+    }
+    join_workers();
+
+    // Anything still queued is answered so no caller waits forever
+    std::deque<Request> abandoned;
+    {
+        std::lock_guard lock(mutex_);
+        abandoned.swap(requests_);
+    }
+    for (Request& request : abandoned) {
+        complete(request, {request.path, std::unexpected(std::string("compile service stopped"))});
+    }
+}
+
+void CompileService::join_workers()
+{
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+        workers.swap(workers_);
+    }
+    work_cv_.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+std::future<CompileService::CompileResult> CompileService::submit(const std::filesystem::path& path)
+{
+    Request request;
+    request.path = path;
+    std::future<CompileResult> result = request.promise.get_future();
+    enqueue(std::move(request));
+    return result;
+}
+
+void CompileService::submit(const std::filesystem::path& path, Completion on_done)
+{
+    Request request;
+    request.path = path;
+    request.on_done = std::move(on_done);
+    enqueue(std::move(request));
+}
+
+void CompileService::enqueue(Request request)
+{
+    {
+        std::lock_guard lock(mutex_);
+        if (running_) {
+            requests_.push_back(std::move(request));
+            work_cv_.notify_one();
+            return;
+        }
+    }
+    complete(request, {request.path, std::unexpected(std::string("compile service not running"))});
+}
+
+void CompileService::complete(Request& request, CompileResult result)
+{
+    if (!request.on_done) {
+        request.promise.set_value(std::move(result));
+        return;
+    }
+    try {
+        request.on_done(std::move(result));
+    } catch (const std::exception& e) {
+        std::cerr << "[CompileService] Exception in completion for " << request.path << ": " << e.what() << "\n";
+    }
+}
+
+std::vector<CompileService::CompileResult> CompileService::compile_all(const std::vector<std::filesystem::path>& paths)
+{
+    std::vector<std::future<CompileResult>> pending;
+    pending.reserve(paths.size());
+    for (const auto& path : paths) {
+        pending.push_back(submit(path));
+    }
+
+    std::vector<CompileResult> results;
+    results.reserve(paths.size());
+    for (auto& future : pending) {
+        results.push_back(future.get());
+    }
+    return results;
+}
+
+std::size_t CompileService::worker_count() const
+{
+    std::lock_guard lock(mutex_);
+    return workers_.size();
+}
+
+void CompileService::worker_loop()
+{
+    // Scratch state is private to this worker, parsing needs no libraries
+    lua_State* scratch = luaL_newstate();
+
+    while (true) {
+        Request request;
+        {
+            std::unique_lock lock(mutex_);
+            work_cv_.wait(lock, [this] { return stopping_ || !requests_.empty(); });
+            if (stopping_) {
+                break;
+            }
+            request = std::move(requests_.front());
+            requests_.pop_front();
+        }
+
+        CompileResult result{request.path, std::unexpected(std::string())};
+        try {
+            result.chunk = cache_.fetch(request.path, scratch);
+        } catch (const std::exception& e) {
+            result.chunk = std::unexpected(std::string(e.what()));
+        }
+        lua_settop(scratch, 0);
+        complete(request, std::move(result));
+    }
+
+    lua_close(scratch);
+}
@@ -0,0 +1,341 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/CoroutineScheduler.cpp
+#include "Scripting/CoroutineScheduler.h"
+
+#include <iostream>
+
+// Count hook: preempt the running coroutine once its instruction budget is spent
+static void budget_hook(lua_State* L, lua_Debug* ar)
+{
+    if (ar->event == LUA_HOOKCOUNT && lua_isyieldable(L)) {
+        lua_yield(L, 0);
+    }
+}
+
+// wait(ms): suspend the calling task for at least `ms` milliseconds
+static int lua_wait(lua_State* L)
+{
+    const lua_Number ms = luaL_optnumber(L, 1, 0);
+    lua_settop(L, 0);
+    lua_pushnumber(L, ms);
+    return lua_yield(L, 1);
+}
+
+// yield(): give up the rest of this slice, resume on the next round
+static int lua_yield_slice(lua_State* L)
+{
+    lua_settop(L, 0);
+    return lua_yield(L, 0);
+}
+
+void CoroutineScheduler::register_api(sol::state& lua)
+{
+    lua_register(lua.lua_state(), "wait", &lua_wait);
+    lua_register(lua.lua_state(), "yield", &lua_yield_slice);
+}
+
+void CoroutineScheduler::start(const StateHook& warm, const int instruction_budget, const bool size_class_allocator)
+{
+    if (running_) {
+        return;
+    }
+
+    instruction_budget_ = instruction_budget;
+    auto state = LuaStatePool::make_state(size_class_allocator);
+    if (warm) {
+        warm(*state);
+    }
+    register_api(state->lua);
+    {
+        std::lock_guard lock(mutex_);
+        state_ = std::move(state);
+    }
+
+    stop_requested_ = false;
+    running_ = true;
+    thread_ = std::thread([this] { run_loop(); });
+    std::cout << "[CoroutineScheduler] Started, budget " << instruction_budget << " instructions per slice\n";
+}
+
+void CoroutineScheduler::stop()
+{
+    if (!running_) {
+        return;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        stop_requested_ = true;
+    }
+    wake_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    // Threads reference the state, so they go before it does
+    {
+        std::lock_guard lock(mutex_);
+        tasks_.clear();
+        pending_updates_.clear();
+        pending_spawns_.clear();
+        pending_kills_.clear();
+        state_.reset();
+    }
+    running_ = false;
+    std::cout << "[CoroutineScheduler] Stopped\n";
+}
+
+std::expected<CoroutineScheduler::TaskId, std::string> CoroutineScheduler::spawn(const std::filesystem::path& path)
+{
+    if (!running_) {
+        return std::unexpected("scheduler is not running");
+    }
+
+    TaskId id;
+    {
+        std::lock_guard lock(mutex_);
+        id = next_id_++;
+        Task task;
+        task.info.id = id;
+        task.info.path = path;
+        tasks_.emplace(id, std::move(task));
+        pending_spawns_.push_back(id);
+    }
+    wake_cv_.notify_all();
+    return id;
+}
+
+bool CoroutineScheduler::kill(const TaskId id)
+{
+    {
+        std::lock_guard lock(mutex_);
+        if (!tasks_.contains(id)) {
+            return false;
+        }
+        pending_kills_.push_back(id);
+    }
+    wake_cv_.notify_all();
+    return true;
+}
+
+void CoroutineScheduler::post(StateHook update)
+{
+    {
+        // Checked under the mutex: once stop() has set the flag, an update would land after the final clear and
+        // never be applied or released
+        std::lock_guard lock(mutex_);
+        if (!running_ || stop_requested_) {
+            return;
+        }
+        pending_updates_.push_back(std::move(update));
+    }
+    wake_cv_.notify_all();
+}
+
+void CoroutineScheduler::clear_finished()
+{
+    std::lock_guard lock(mutex_);
+    std::erase_if(tasks_, [](const auto& entry) {
+        const TaskStatus status = entry.second.info.status;
+        return status == TaskStatus::FINISHED || status == TaskStatus::FAILED || status == TaskStatus::KILLED;
+    });
+}
+
+void CoroutineScheduler::set_gc_policy(const GcPolicy& policy)
+{
+    {
+        std::lock_guard lock(mutex_);
+        gc_policy_ = policy;
+        gc_policy_dirty_ = true;
+    }
+    wake_cv_.notify_all();
+}
+
+GcStats CoroutineScheduler::gc_stats() const
+{
+    std::lock_guard lock(mutex_);
+    return gc_stats_;
+}
+
+std::optional<LuaAllocator::Stats> CoroutineScheduler::memory_stats() const
+{
+    std::lock_guard lock(mutex_);
+    if (!state_ || !state_->allocator) {
+        return std::nullopt;
+    }
+    return state_->allocator->stats();
+}
+
+std::optional<FrameArena::Stats> CoroutineScheduler::frame_stats() const
+{
+    std::lock_guard lock(mutex_);
+    if (!state_) {
+        return std::nullopt;
+    }
+    return state_->frame.stats();
+}
+
+std::vector<CoroutineScheduler::TaskInfo> CoroutineScheduler::tasks() const
+{
+    std::lock_guard lock(mutex_);
+    std::vector<TaskInfo> out;
+    out.reserve(tasks_.size());
+    for (const auto& [id, task] : tasks_) {
+        out.push_back(task.info);
+    }
+    return out;
+}
+
+void CoroutineScheduler::apply_pending()
+{
+    std::vector<StateHook> updates;
+    std::vector<TaskId> spawns;
+    std::vector<TaskId> kills;
+    std::optional<GcPolicy> gc_policy;
+    {
+        std::lock_guard lock(mutex_);
+        updates.swap(pending_updates_);
+        spawns.swap(pending_spawns_);
+        kills.swap(pending_kills_);
+        if (gc_policy_dirty_) {
+            gc_policy = gc_policy_;
+            gc_policy_dirty_ = false;
+        }
+    }
+
+    if (gc_policy) {
+        GcController::apply(state_->lua.lua_state(), *gc_policy);
+    }
+
+    for (const StateHook& update : updates) {
+        try {
+            update(*state_);
+        } catch (const std::exception& e) {
+            std::cerr << "[CoroutineScheduler] Exception applying update: " << e.what() << "\n";
+        }
+    }
+
+    std::lock_guard lock(mutex_);
+    for (const TaskId id : spawns) {
+        auto it = tasks_.find(id);
+        if (it == tasks_.end()) {
+            continue;
+        }
+        Task& task = it->second;
+        auto chunk = state_->chunks.find(task.info.path);
+        if (chunk == state_->chunks.end()) {
+            task.info.status = TaskStatus::FAILED;
+            task.info.error = "script not loaded";
+            std::cerr << "[CoroutineScheduler] Script not loaded: " << task.info.path << "\n";
+            continue;
+        }
+
+        task.thread = sol::thread::create(state_->lua.lua_state());
+        task.co = task.thread.thread_state();
+        chunk->second.push(task.co);
+        lua_sethook(task.co, &budget_hook, LUA_MASKCOUNT, instruction_budget_);
+    }
+
+    for (const TaskId id : kills) {
+        auto it = tasks_.find(id);
+        if (it == tasks_.end() || it->second.info.status == TaskStatus::FINISHED || it->second.info.status == TaskStatus::FAILED) {
+            continue;
+        }
+        it->second.info.status = TaskStatus::KILLED;
+        it->second.thread = sol::thread();
+        it->second.co = nullptr;
+    }
+}
+
+void CoroutineScheduler::resume(Task& task)
+{
+    int nres = 0;
+    const auto began = std::chrono::steady_clock::now();
+    const int status = lua_resume(task.co, nullptr, 0, &nres);
+    const auto ended = std::chrono::steady_clock::now();
+
+    std::lock_guard lock(mutex_);
+    task.info.resumes++;
+    task.info.cpu_time += std::chrono::duration_cast<std::chrono::microseconds>(ended - began);
+
+    if (status == LUA_YIELD) {
+        // wait(ms) yields one number, budget preemption and yield() yield nothing
+        if (nres >= 1 && lua_type(task.co, -nres) == LUA_TNUMBER) {
+            const auto ms = std::chrono::duration<double, std::milli>(lua_tonumber(task.co, -nres));
+            task.wake_at = ended + std::chrono::duration_cast<std::chrono::steady_clock::duration>(ms);
+            task.info.status = TaskStatus::WAITING;
+        } else {
+            task.info.status = TaskStatus::READY;
+        }
+        lua_pop(task.co, nres);
+        return;
+    }
+
+    if (status == LUA_OK) {
+        task.info.status = TaskStatus::FINISHED;
+    } else {
+        const char* message = lua_tostring(task.co, -1);
+        task.info.status = TaskStatus::FAILED;
+        task.info.error = message ? message : "unknown error";
+        std::cerr << "[CoroutineScheduler] Task " << task.info.id << " (" << task.info.path << ") failed: " << task.info.error << "\n";
+    }
+    task.thread = sol::thread();
+    task.co = nullptr;
+}
+
+void CoroutineScheduler::run_loop()
+{
+    while (!stop_requested_) {
+        apply_pending();
+
+        // Round-robin over runnable tasks, one slice each
+        std::vector<Task*> runnable;
+        auto next_wake = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+        {
+            std::lock_guard lock(mutex_);
+            const auto now = std::chrono::steady_clock::now();
+            for (auto& [id, task] : tasks_) {
+                if (!task.co) {
+                    continue;
+                }
+                if (task.info.status == TaskStatus::WAITING && task.wake_at > now) {
+                    next_wake = std::min(next_wake, task.wake_at);
+                    continue;
+                }
+                runnable.push_back(&task);
+            }
+        }
+
+        // Tasks are only erased by clear_finished(), which skips live coroutines, so the pointers stay valid
+        {
+            FrameArena::Scope frame(state_->frame); // One frame per round, reset before the idle GC step
+            for (Task* task : runnable) {
+                if (stop_requested_) {
+                    break;
+                }
+                resume(*task);
+            }
+        }
+
+        // Between ticks: bounded collection work, never in the middle of a resume
+        std::optional<GcPolicy> gc_policy;
+        GcStats gc_stats;
+        {
+            std::lock_guard lock(mutex_);
+            gc_policy = gc_policy_;
+            gc_stats = gc_stats_;
+        }
+        if (gc_policy && !runnable.empty()) {
+            GcController::idle_step(state_->lua.lua_state(), *gc_policy, gc_stats);
+            std::lock_guard lock(mutex_);
+            gc_stats_ = gc_stats;
+        }
+
+        if (runnable.empty()) {
+            std::unique_lock lock(mutex_);
+            wake_cv_.wait_until(lock, next_wake, [this] {
+                return stop_requested_ || !pending_updates_.empty() || !pending_spawns_.empty() || !pending_kills_.empty();
+            });
+        }
+    }
+}
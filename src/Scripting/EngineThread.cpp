@@ -0,0 +1,139 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/EngineThread.cpp
+#include "Scripting/EngineThread.h"
+
+#include <iostream>
+
+EngineThread::EngineThread(sol::state& state) : state_(&state), head_(new Node), tail_(head_.load()) {}
+
+EngineThread::~EngineThread()
+{
+    stop();
+    while (Node* node = tail_) {
+        tail_ = node->next.load();
+        delete node;
+    }
+}
+
+void EngineThread::start()
+{
+    if (running()) {
+        return;
+    }
+    stop_requested_ = false;
+    thread_ = std::thread([this] { run_loop(); });
+    thread_id_ = thread_.get_id();
+    running_.store(true, std::memory_order_release);
+    std::cout << "[EngineThread] Started\n";
+}
+
+void EngineThread::stop()
+{
+    if (!running()) {
+        return;
+    }
+    stop_requested_ = true;
+    pushed_.fetch_add(1, std::memory_order_release);
+    pushed_.notify_one();
+    thread_.join();
+    thread_id_ = std::thread::id();
+    running_.store(false, std::memory_order_seq_cst);
+
+    // A producer that saw running() before the flag dropped may still be linking; once the count is zero every
+    // such command is in the queue, and later producers run inline
+    for (std::uint32_t active = producers_.load(std::memory_order_seq_cst); active != 0;
+         active = producers_.load(std::memory_order_seq_cst)) {
+        producers_.wait(active, std::memory_order_seq_cst);
+    }
+    drain();
+    std::cout << "[EngineThread] Stopped\n";
+}
+
+bool EngineThread::enter_queue()
+{
+    // Counted before the check, both seq_cst: either stop() sees this producer, or this producer sees the flag down
+    producers_.fetch_add(1, std::memory_order_seq_cst);
+    if (running_.load(std::memory_order_seq_cst) && !on_engine_thread()) {
+        return true;
+    }
+    leave_queue();
+    return false;
+}
+
+void EngineThread::leave_queue()
+{
+    if (producers_.fetch_sub(1, std::memory_order_seq_cst) == 1) {
+        producers_.notify_all();
+    }
+}
+
+void EngineThread::push(Command command)
+{
+    auto* node = new Node;
+    node->command = std::move(command);
+    Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+    pushed_.fetch_add(1, std::memory_order_release);
+    pushed_.notify_one();
+}
+
+EngineThread::Node* EngineThread::pop()
+{
+    Node* next = tail_->next.load(std::memory_order_acquire);
+    if (!next) {
+        return nullptr;
+    }
+    delete tail_;
+    tail_ = next; // Becomes the new stub once its command is taken
+    return next;
+}
+
+void EngineThread::run_command(Command command)
+{
+    try {
+        command(*state_);
+    } catch (const std::exception& e) {
+        std::cerr << "[EngineThread] Exception in command: " << e.what() << "\n";
+    }
+    commands_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void EngineThread::drain()
+{
+    std::uint64_t batch = 0;
+    while (Node* node = pop()) {
+        run_command(std::move(node->command));
+        node->command = nullptr;
+        batch++;
+    }
+    if (batch > 0) {
+        batches_.fetch_add(1, std::memory_order_relaxed);
+        if (batch > max_batch_.load(std::memory_order_relaxed)) {
+            max_batch_.store(batch, std::memory_order_relaxed);
+        }
+    }
+}
+
+void EngineThread::run_loop()
+{
+    while (true) {
+        const std::uint64_t seen = pushed_.load(std::memory_order_acquire);
+        drain();
+        if (stop_requested_) {
+            drain();
+            return;
+        }
+        // Wakes as soon as a push links after `seen`, including one that was mid-link during the drain
+        pushed_.wait(seen, std::memory_order_acquire);
+    }
+}
+
+EngineThread::Stats EngineThread::stats() const
+{
+    Stats stats;
+    stats.commands = commands_.load(std::memory_order_relaxed);
+    stats.batches = batches_.load(std::memory_order_relaxed);
+    stats.max_batch = max_batch_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,335 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/FileWatcher.cpp
+#include "Scripting/FileWatcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+fs::path FileWatcher::normalise(const fs::path& path)
+{
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path, ec);
+    return (ec ? path : absolute).lexically_normal();
+}
+
+bool FileWatcher::start(ChangeHandler on_change, const std::chrono::milliseconds debounce)
+{
+    if (running_) {
+        return true;
+    }
+    on_change_ = std::move(on_change);
+    debounce_ = debounce;
+    stop_requested_ = false;
+
+#ifdef __linux__
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_fd_ >= 0 && wake_fd_ >= 0) {
+        {
+            std::lock_guard lock(mutex_);
+            for (auto& [dir, watched] : dirs_) {
+                add_directory_watch(dir, watched);
+            }
+        }
+        running_ = true;
+        thread_ = std::thread([this] { run_inotify(); });
+        std::cout << "[FileWatcher] Started (inotify), " << directory_count() << " directories\n";
+        return true;
+    }
+
+    std::cerr << "[FileWatcher] inotify unavailable (" << std::strerror(errno) << "), falling back to polling\n";
+    if (inotify_fd_ >= 0) {
+        close(inotify_fd_);
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+    }
+    inotify_fd_ = -1;
+    wake_fd_ = -1;
+#endif
+
+    running_ = true;
+    thread_ = std::thread([this] { run_polling(); });
+    std::cout << "[FileWatcher] Started (polling)\n";
+    return true;
+}
+
+void FileWatcher::stop()
+{
+    if (!running_) {
+        return;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        stop_requested_ = true;
+    }
+    stop_cv_.notify_all();
+#ifdef __linux__
+    if (wake_fd_ >= 0) {
+        const std::uint64_t one = 1;
+        [[maybe_unused]] const auto written = write(wake_fd_, &one, sizeof(one));
+    }
+#endif
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+#ifdef __linux__
+    // Closing the inotify descriptor drops every watch with it
+    if (inotify_fd_ >= 0) {
+        close(inotify_fd_);
+    }
+    if (wake_fd_ >= 0) {
+        close(wake_fd_);
+    }
+    inotify_fd_ = -1;
+    wake_fd_ = -1;
+#endif
+    {
+        std::lock_guard lock(mutex_);
+        for (auto& [dir, watched] : dirs_) {
+            watched.wd = -1;
+        }
+        wd_dirs_.clear();
+    }
+    pending_.clear();
+    running_ = false;
+    std::cout << "[FileWatcher] Stopped\n";
+}
+
+void FileWatcher::watch(const fs::path& path)
+{
+    const fs::path key = normalise(path);
+    std::lock_guard lock(mutex_);
+    if (files_.contains(key)) {
+        return;
+    }
+
+    WatchedFile file{path};
+    std::error_code ec;
+    file.last_write = fs::last_write_time(key, ec);
+    files_.emplace(key, std::move(file));
+
+    const fs::path dir = key.parent_path();
+    WatchedDir& watched = dirs_[dir];
+    if (watched.files++ == 0) {
+        add_directory_watch(dir, watched);
+    }
+}
+
+void FileWatcher::unwatch(const fs::path& path)
+{
+    const fs::path key = normalise(path);
+    std::lock_guard lock(mutex_);
+    if (files_.erase(key) == 0) {
+        return;
+    }
+
+    auto dir = dirs_.find(key.parent_path());
+    if (dir == dirs_.end() || --dir->second.files > 0) {
+        return;
+    }
+#ifdef __linux__
+    if (dir->second.wd >= 0) {
+        inotify_rm_watch(inotify_fd_, dir->second.wd);
+        wd_dirs_.erase(dir->second.wd);
+    }
+#endif
+    dirs_.erase(dir);
+}
+
+std::size_t FileWatcher::watched_count() const
+{
+    std::lock_guard lock(mutex_);
+    return files_.size();
+}
+
+std::size_t FileWatcher::directory_count() const
+{
+    std::lock_guard lock(mutex_);
+    return dirs_.size();
+}
+
+// Called with mutex_ held
+void FileWatcher::add_directory_watch(const fs::path& dir, WatchedDir& watched)
+{
+#ifdef __linux__
+    if (inotify_fd_ < 0 || watched.wd >= 0) {
+        return;
+    }
+    // MOVED_TO/CREATE cover editors that save through a temp file and rename
+    const int wd = inotify_add_watch(inotify_fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0) {
+        std::cerr << "[FileWatcher] Failed to watch " << dir << ": " << std::strerror(errno) << "\n";
+        return;
+    }
+    watched.wd = wd;
+    wd_dirs_[wd] = dir;
+#else
+    (void)dir;
+    (void)watched;
+#endif
+}
+
+void FileWatcher::note_event(const fs::path& file, const Clock::time_point now)
+{
+    fs::path original;
+    {
+        std::lock_guard lock(mutex_);
+        auto it = files_.find(file);
+        if (it == files_.end()) {
+            return; // Something else in a watched directory
+        }
+        original = it->second.path;
+    }
+
+    auto [pending, inserted] = pending_.try_emplace(file, PendingChange{{original, now}, now});
+    if (!inserted) {
+        pending->second.last_seen = now;
+    }
+}
+
+void FileWatcher::flush_ready(const Clock::time_point now)
+{
+    std::vector<Change> ready;
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        if (now - it->second.last_seen >= debounce_) {
+            ready.push_back(std::move(it->second.change));
+            it = pending_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (!ready.empty()) {
+        deliver(ready);
+    }
+}
+
+void FileWatcher::deliver(const std::vector<Change>& changes) const
+{
+    try {
+        on_change_(changes);
+    } catch (const std::exception& e) {
+        std::cerr << "[FileWatcher] Exception in change handler: " << e.what() << "\n";
+    }
+}
+
+void FileWatcher::run_inotify()
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[16 * 1024];
+
+    while (!stop_requested_) {
+        // Sleep until an event arrives, or until the oldest pending burst has gone quiet
+        int timeout_ms = -1;
+        if (!pending_.empty()) {
+            Clock::time_point due = Clock::time_point::max();
+            for (const auto& [file, pending] : pending_) {
+                due = std::min(due, pending.last_seen + debounce_);
+            }
+            const auto wait = std::chrono::ceil<std::chrono::milliseconds>(due - Clock::now());
+            timeout_ms = static_cast<int>(std::max<std::chrono::milliseconds::rep>(0, wait.count()));
+        }
+
+        pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+        if (poll(fds, 2, timeout_ms) < 0 && errno != EINTR) {
+            std::cerr << "[FileWatcher] poll failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+
+        const auto now = Clock::now();
+        if (fds[0].revents & POLLIN) {
+            ssize_t length;
+            while ((length = read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+                for (char* ptr = buffer; ptr < buffer + length;) {
+                    const auto* event = reinterpret_cast<const inotify_event*>(ptr);
+                    ptr += sizeof(inotify_event) + event->len;
+
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        // Events were dropped, treat every watched file as touched; unchanged ones are skipped by hash
+                        std::vector<fs::path> all;
+                        {
+                            std::lock_guard lock(mutex_);
+                            for (const auto& [file, watched] : files_) {
+                                all.push_back(file);
+                            }
+                        }
+                        for (const auto& file : all) {
+                            note_event(file, now);
+                        }
+                        continue;
+                    }
+
+                    fs::path dir;
+                    {
+                        std::lock_guard lock(mutex_);
+                        auto it = wd_dirs_.find(event->wd);
+                        if (it == wd_dirs_.end()) {
+                            continue;
+                        }
+                        dir = it->second;
+                        if (event->mask & IN_IGNORED) {
+                            // Directory was removed or unmounted, the kernel dropped the watch
+                            if (auto watched = dirs_.find(dir); watched != dirs_.end()) {
+                                watched->second.wd = -1;
+                            }
+                            wd_dirs_.erase(it);
+                            continue;
+                        }
+                    }
+                    if (event->len > 0) {
+                        note_event(dir / event->name, now);
+                    }
+                }
+            }
+        }
+
+        flush_ready(Clock::now());
+    }
+#endif
+}
+
+void FileWatcher::run_polling()
+{
+    while (true) {
+        {
+            std::unique_lock lock(mutex_);
+            if (stop_cv_.wait_for(lock, std::chrono::milliseconds(750), [this] { return stop_requested_.load(); })) {
+                break;
+            }
+        }
+
+        std::vector<Change> changes;
+        const auto now = Clock::now();
+        {
+            std::lock_guard lock(mutex_);
+            for (auto& [file, watched] : files_) {
+                std::error_code ec;
+                const auto current = fs::last_write_time(file, ec);
+                if (!ec && current != watched.last_write) {
+                    watched.last_write = current;
+                    changes.push_back({watched.path, now});
+                }
+            }
+        }
+        if (!changes.empty()) {
+            deliver(changes);
+        }
+    }
+}
@@ -0,0 +1,293 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/FrameArena.cpp
+#include "Scripting/FrameArena.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+// A state only runs on the thread that leased it, so bindings find its arena here
+static thread_local FrameArena* current_arena = nullptr;
+
+static constexpr std::size_t max_buffer_doubles = std::size_t{1} << 24;
+
+bool FrameBuffer::valid() const
+{
+    return arena_ && arena_->slot_for(slot_, generation_) != nullptr;
+}
+
+std::size_t FrameBuffer::size() const
+{
+    auto* slot = arena_ ? arena_->slot_for(slot_, generation_) : nullptr;
+    return slot ? slot->size : 0;
+}
+
+double* FrameBuffer::data() const
+{
+    auto* slot = arena_ ? arena_->slot_for(slot_, generation_) : nullptr;
+    return slot ? slot->storage.data() : nullptr;
+}
+
+void FrameBuffer::release()
+{
+    if (arena_) {
+        arena_->release_slot(slot_, generation_);
+    }
+}
+
+int sol_lua_push(sol::types<FrameBuffer>, lua_State* L, const FrameBuffer& buffer)
+{
+    FrameArena::BufferSlot* slot = buffer.arena_ ? buffer.arena_->slot_for(buffer.slot_, buffer.generation_) : nullptr;
+    if (slot && slot->lua_handle != LUA_NOREF) {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, slot->lua_handle);
+        *sol::stack::get<FrameBuffer*>(L, -1) = buffer; // Now carries this lease's generation
+        return 1;
+    }
+
+    sol::stack::push<sol::detail::as_value_tag<FrameBuffer>>(L, buffer);
+    if (slot) {
+        // An arena serves one state, so the cached handle is valid on every thread of it
+        lua_pushvalue(L, -1);
+        slot->lua_handle = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+    return 1;
+}
+
+FrameArena::FrameArena(const std::size_t block_size) : block_size_(block_size) {}
+
+FrameArena::~FrameArena()
+{
+    run_destructors();
+}
+
+FrameArena* FrameArena::current()
+{
+    return current_arena;
+}
+
+FrameArena::Scope::Scope(FrameArena& arena) : arena_(arena), previous_(current_arena)
+{
+    current_arena = &arena_;
+}
+
+FrameArena::Scope::~Scope()
+{
+    current_arena = previous_;
+    arena_.reset();
+}
+
+void* FrameArena::do_allocate(const std::size_t bytes, const std::size_t alignment)
+{
+    while (true) {
+        if (block_index_ < blocks_.size()) {
+            Block& block = blocks_[block_index_];
+            const auto base = reinterpret_cast<std::uintptr_t>(block.memory.get());
+            const std::size_t aligned = ((base + offset_ + alignment - 1) & ~(alignment - 1)) - base;
+            if (aligned + bytes <= block.size) {
+                offset_ = aligned + bytes;
+                const std::size_t in_use = bytes_in_use_.load(std::memory_order_relaxed) + bytes;
+                bytes_in_use_.store(in_use, std::memory_order_relaxed);
+                if (in_use > peak_bytes_.load(std::memory_order_relaxed)) {
+                    peak_bytes_.store(in_use, std::memory_order_relaxed);
+                }
+                return block.memory.get() + aligned;
+            }
+            if (block_index_ + 1 < blocks_.size()) {
+                // Kept from an earlier frame, move on without touching the heap
+                block_index_++;
+                offset_ = 0;
+                continue;
+            }
+        }
+
+        // Oversized requests get a block of their own, kept for reuse like any other
+        const std::size_t size = std::max(block_size_, bytes + alignment);
+        blocks_.push_back({std::make_unique<std::byte[]>(size), size});
+        bytes_reserved_.store(bytes_reserved_.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+        block_allocations_.store(block_allocations_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        block_index_ = blocks_.size() - 1;
+        offset_ = 0;
+    }
+}
+
+FrameBuffer FrameArena::lease_buffer(const std::size_t count)
+{
+    if (count == 0 || count > max_buffer_doubles) {
+        throw std::length_error("frame buffer size out of range: " + std::to_string(count));
+    }
+    const std::size_t capacity = std::bit_ceil(count);
+
+    // Smallest released buffer that already fits, else any released one (it grows once), else a new slot
+    auto best = free_slots_.end();
+    for (auto it = free_slots_.begin(); it != free_slots_.end(); ++it) {
+        const std::size_t have = slots_[*it].storage.size();
+        if (best == free_slots_.end()) {
+            best = it;
+            continue;
+        }
+        const std::size_t best_have = slots_[*best].storage.size();
+        if (have >= capacity && (best_have < capacity || have < best_have)) {
+            best = it;
+        }
+    }
+
+    std::uint32_t index;
+    if (best != free_slots_.end()) {
+        index = *best;
+        *best = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        index = static_cast<std::uint32_t>(slots_.size());
+        slots_.emplace_back();
+    }
+
+    BufferSlot& slot = slots_[index];
+    if (slot.storage.size() < capacity) {
+        slot.storage.resize(capacity);
+    }
+    std::fill_n(slot.storage.begin(), count, 0.0);
+    slot.size = count;
+    slot.leased = true;
+    buffers_leased_.store(buffers_leased_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return {this, index, slot.generation};
+}
+
+FrameArena::BufferSlot* FrameArena::slot_for(const std::uint32_t slot, const std::uint64_t generation)
+{
+    if (slot >= slots_.size() || !slots_[slot].leased || slots_[slot].generation != generation) {
+        return nullptr;
+    }
+    return &slots_[slot];
+}
+
+void FrameArena::release_slot(const std::uint32_t slot, const std::uint64_t generation)
+{
+    BufferSlot* buffer = slot_for(slot, generation);
+    if (!buffer) {
+        return; // Already released, closing twice is harmless
+    }
+    buffer->leased = false;
+    buffer->generation++;
+    buffers_leased_.store(buffers_leased_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    free_slots_.push_back(slot);
+}
+
+void FrameArena::run_destructors()
+{
+    while (destructors_) {
+        Destructor* node = destructors_;
+        destructors_ = node->next;
+        node->destroy(node->object);
+    }
+}
+
+void FrameArena::reset()
+{
+    run_destructors();
+    for (std::uint32_t i = 0; i < slots_.size(); ++i) {
+        release_slot(i, slots_[i].generation);
+    }
+    block_index_ = 0;
+    offset_ = 0;
+    bytes_in_use_.store(0, std::memory_order_relaxed);
+    resets_.store(resets_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+FrameArena::Stats FrameArena::stats() const
+{
+    Stats stats;
+    stats.bytes_in_use = bytes_in_use_.load(std::memory_order_relaxed);
+    stats.bytes_reserved = bytes_reserved_.load(std::memory_order_relaxed);
+    stats.peak_bytes = peak_bytes_.load(std::memory_order_relaxed);
+    stats.buffers_leased = buffers_leased_.load(std::memory_order_relaxed);
+    stats.resets = resets_.load(std::memory_order_relaxed);
+    stats.block_allocations = block_allocations_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// The handle's methods and elements are served by plain C functions. A usertype with a custom __index
+// makes sol push a fresh closure on every method lookup, which would allocate on each buf:release().
+// They raise errors with luaL_error, so nothing with a destructor may be alive when they do.
+static FrameBuffer* self_buffer(lua_State* L)
+{
+    const auto buffer = sol::stack::check_get<FrameBuffer*>(L, 1);
+    return buffer ? *buffer : nullptr;
+}
+
+static int buffer_valid(lua_State* L)
+{
+    const FrameBuffer* buffer = self_buffer(L);
+    lua_pushboolean(L, buffer && buffer->valid());
+    return 1;
+}
+
+static int buffer_release(lua_State* L)
+{
+    if (FrameBuffer* buffer = self_buffer(L)) {
+        buffer->release();
+    }
+    return 0;
+}
+
+static double* checked_element(lua_State* L)
+{
+    const FrameBuffer* buffer = self_buffer(L);
+    double* data = buffer ? buffer->data() : nullptr;
+    if (!data) {
+        luaL_error(L, "frame buffer used after release");
+    }
+    const lua_Integer index = luaL_checkinteger(L, 2);
+    if (index < 1 || static_cast<std::size_t>(index) > buffer->size()) {
+        luaL_error(L, "frame buffer index %I out of range", static_cast<LUAI_UACINT>(index));
+    }
+    return data + (index - 1);
+}
+
+static int buffer_index(lua_State* L)
+{
+    if (lua_type(L, 2) == LUA_TSTRING) {
+        const char* key = lua_tostring(L, 2);
+        if (std::strcmp(key, "valid") == 0) {
+            lua_pushcfunction(L, &buffer_valid);
+        } else if (std::strcmp(key, "release") == 0) {
+            lua_pushcfunction(L, &buffer_release);
+        } else {
+            lua_pushnil(L);
+        }
+        return 1;
+    }
+    lua_pushnumber(L, *checked_element(L));
+    return 1;
+}
+
+static int buffer_new_index(lua_State* L)
+{
+    double* element = checked_element(L);
+    *element = luaL_checknumber(L, 3);
+    return 0;
+}
+
+void FrameArena::register_api(sol::state& lua)
+{
+    lua.new_usertype<FrameBuffer>("FrameBuffer", sol::no_constructor,
+        "__close", [](FrameBuffer& buffer, sol::object) { buffer.release(); },
+        sol::meta_function::length, &FrameBuffer::size,
+        sol::meta_function::index, &buffer_index,
+        sol::meta_function::new_index, &buffer_new_index);
+
+    sol::table frame = lua.create_named_table("frame");
+    frame.set_function("buffer", [](const lua_Integer count) {
+        FrameArena* arena = FrameArena::current();
+        if (!arena) {
+            throw std::runtime_error("frame.buffer called outside of a run");
+        }
+        if (count < 1) {
+            throw std::length_error("frame buffer size must be positive");
+        }
+        return arena->lease_buffer(static_cast<std::size_t>(count));
+    });
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/GcPolicy.cpp
+#include "Scripting/GcPolicy.h"
+
+#include <algorithm>
+
+#include <lua.hpp>
+
+void GcController::apply(lua_State* L, const GcPolicy& policy)
+{
+    if (policy.mode == GcPolicy::Mode::GENERATIONAL) {
+        lua_gc(L, LUA_GCGEN, policy.minormul, policy.majormul);
+    } else {
+        lua_gc(L, LUA_GCINC, policy.pause, policy.stepmul, policy.stepsize);
+    }
+
+    if (policy.stop_during_runs) {
+        lua_gc(L, LUA_GCSTOP);
+    } else {
+        lua_gc(L, LUA_GCRESTART);
+    }
+}
+
+std::size_t GcController::heap_bytes(lua_State* L)
+{
+    return static_cast<std::size_t>(lua_gc(L, LUA_GCCOUNT)) * 1024 + static_cast<std::size_t>(lua_gc(L, LUA_GCCOUNTB));
+}
+
+void GcController::idle_step(lua_State* L, const GcPolicy& policy, GcStats& stats)
+{
+    const auto began = std::chrono::steady_clock::now();
+    const std::size_t heap_before = heap_bytes(L);
+    stats.peak_heap_bytes = std::max(stats.peak_heap_bytes, heap_before);
+
+    if (policy.stop_during_runs) {
+        if (policy.full_collect_above_kb > 0 && heap_before > policy.full_collect_above_kb * 1024) {
+            // Idle steps fell behind, catch up in one go while nothing is running
+            lua_gc(L, LUA_GCCOLLECT);
+            stats.full_collections++;
+            stats.cycles++;
+        } else if (policy.mode == GcPolicy::Mode::GENERATIONAL) {
+            // A generational step is a whole (usually minor) collection, one per idle window
+            stats.steps++;
+            stats.cycles++;
+            lua_gc(L, LUA_GCSTEP, policy.idle_step_kb);
+        } else {
+            // LUA_GCSTEP runs even while the collector is stopped, and returns 1 when it finishes a cycle.
+            // A nonzero size would add the whole debt built up during the run, so steps are only bounded at 0.
+            const auto deadline = began + policy.idle_budget;
+            do {
+                stats.steps++;
+                if (lua_gc(L, LUA_GCSTEP, policy.idle_step_kb)) {
+                    stats.cycles++;
+                    break;
+                }
+            } while (std::chrono::steady_clock::now() < deadline);
+        }
+    }
+
+    const auto paused = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - began);
+    if (policy.stop_during_runs) {
+        stats.pause_total += paused;
+        stats.pause_max = std::max(stats.pause_max, paused);
+    }
+    stats.heap_bytes = heap_bytes(L);
+}
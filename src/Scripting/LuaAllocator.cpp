@@ -0,0 +1,182 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/LuaAllocator.cpp
+#include "Scripting/LuaAllocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+LuaAllocator::~LuaAllocator()
+{
+    // The state is closed first, so every small block is back on a free list by now
+    for (void* slab : slabs_) {
+        std::free(slab);
+    }
+}
+
+void* LuaAllocator::allocate(void* ud, void* ptr, const std::size_t osize, const std::size_t nsize)
+{
+    auto* self = static_cast<LuaAllocator*>(ud);
+
+    // For a new block Lua passes the object type in osize, not a size
+    const std::size_t old_size = ptr ? osize : 0;
+
+    if (nsize == 0) {
+        if (ptr) {
+            if (old_size <= max_small && !self->is_foreign(ptr)) {
+                self->free_small(ptr, old_size);
+            } else {
+                if (old_size <= max_small) {
+                    --self->foreign_blocks_;
+                }
+                std::free(ptr);
+                add(self->large_bytes_, -static_cast<std::ptrdiff_t>(old_size));
+            }
+            add(self->bytes_in_use_, -static_cast<std::ptrdiff_t>(old_size));
+        }
+        return nullptr;
+    }
+
+    void* block = self->realloc(ptr, old_size, nsize);
+    if (block) {
+        add(self->bytes_in_use_, static_cast<std::ptrdiff_t>(nsize) - static_cast<std::ptrdiff_t>(old_size));
+    }
+    return block;
+}
+
+void* LuaAllocator::realloc(void* ptr, const std::size_t osize, const std::size_t nsize)
+{
+    const bool foreign = ptr && osize <= max_small && is_foreign(ptr);
+    const bool was_small = ptr && osize <= max_small && !foreign;
+    const bool now_small = nsize <= max_small;
+
+    // Large blocks are accounted at the size Lua knows them by, foreign ones included
+    const auto resize_large = [this, osize, nsize] {
+        add(large_bytes_, static_cast<std::ptrdiff_t>(nsize) - static_cast<std::ptrdiff_t>(osize));
+    };
+
+    // Large to large stays with the system allocator, which can often grow in place
+    if (ptr && !was_small && !now_small) {
+        void* block = std::realloc(ptr, nsize);
+        if (!block && nsize <= osize) {
+            block = ptr;
+        }
+        if (block) {
+            resize_large();
+            if (foreign) {
+                --foreign_blocks_;
+            }
+        }
+        return block;
+    }
+
+    // Same size class: the block already fits
+    if (was_small && now_small && class_of(osize) == class_of(nsize)) {
+        return ptr;
+    }
+
+    void* block = nullptr;
+    if (now_small) {
+        block = alloc_small(nsize);
+    } else {
+        block = std::malloc(nsize);
+        if (block) {
+            add(large_bytes_, static_cast<std::ptrdiff_t>(nsize));
+            bump(large_allocs_);
+        }
+    }
+    if (!block) {
+        if (!ptr || nsize > osize) {
+            return nullptr; // Lua treats a failed grow as out of memory and keeps the old block
+        }
+        // Lua 5.4 assumes a shrink never fails, so the block stays where it is. A smaller small class can
+        // take a block from a bigger one; a system block now sized as small is remembered as foreign.
+        if (!was_small) {
+            resize_large();
+            if (now_small && !foreign) {
+                ++foreign_blocks_;
+            }
+        }
+        return ptr;
+    }
+
+    if (ptr) {
+        std::memcpy(block, ptr, std::min(osize, nsize));
+        if (was_small) {
+            free_small(ptr, osize);
+        } else {
+            std::free(ptr);
+            add(large_bytes_, -static_cast<std::ptrdiff_t>(osize));
+            if (foreign) {
+                --foreign_blocks_;
+            }
+        }
+    }
+    return block;
+}
+
+void* LuaAllocator::alloc_small(const std::size_t size)
+{
+    SizeClass& size_class = classes_[class_of(size)];
+    bump(small_allocs_);
+
+    if (FreeBlock* block = size_class.free_list) {
+        size_class.free_list = block->next;
+        return block;
+    }
+
+    const std::size_t block_size = (class_of(size) + 1) * granularity;
+    if (!size_class.bump || size_class.bump + block_size > size_class.bump_end) {
+        void* slab = std::malloc(slab_size);
+        if (!slab) {
+            return nullptr;
+        }
+        try {
+            slabs_.push_back(slab);
+        } catch (const std::bad_alloc&) {
+            // Must not throw through Lua
+            std::free(slab);
+            return nullptr;
+        }
+        add(slab_bytes_, static_cast<std::ptrdiff_t>(slab_size));
+        size_class.bump = static_cast<char*>(slab);
+        size_class.bump_end = size_class.bump + slab_size;
+    }
+
+    void* block = size_class.bump;
+    size_class.bump += block_size;
+    return block;
+}
+
+void LuaAllocator::free_small(void* ptr, const std::size_t size)
+{
+    SizeClass& size_class = classes_[class_of(size)];
+    auto* block = static_cast<FreeBlock*>(ptr);
+    block->next = size_class.free_list;
+    size_class.free_list = block;
+}
+
+bool LuaAllocator::is_foreign(const void* ptr) const
+{
+    if (foreign_blocks_ == 0) {
+        return false;
+    }
+    const auto* address = static_cast<const char*>(ptr);
+    return std::none_of(slabs_.begin(), slabs_.end(), [address](void* slab) {
+        const auto* begin = static_cast<const char*>(slab);
+        return address >= begin && address < begin + slab_size;
+    });
+}
+
+LuaAllocator::Stats LuaAllocator::stats() const
+{
+    Stats stats;
+    stats.bytes_in_use = bytes_in_use_.load(std::memory_order_relaxed);
+    stats.slab_bytes = slab_bytes_.load(std::memory_order_relaxed);
+    stats.large_bytes = large_bytes_.load(std::memory_order_relaxed);
+    stats.small_allocs = small_allocs_.load(std::memory_order_relaxed);
+    stats.large_allocs = large_allocs_.load(std::memory_order_relaxed);
+    return stats;
+}
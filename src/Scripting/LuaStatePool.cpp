@@ -0,0 +1,140 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/LuaStatePool.cpp
+#include "Scripting/LuaStatePool.h"
+
+#include <iostream>
+
+std::unique_ptr<LuaStatePool::PooledState> LuaStatePool::make_state(const bool size_class_allocator)
+{
+    if (size_class_allocator) {
+        return std::make_unique<PooledState>(std::make_unique<LuaAllocator>());
+    }
+    return std::make_unique<PooledState>();
+}
+
+void LuaStatePool::resize(const std::size_t count, const StateHook& warm)
+{
+    std::unique_lock lock(mutex_);
+
+    // Shrink: wait for each surplus state to go idle before dropping it
+    while (states_.size() > count) {
+        PooledState* last = states_.back().get();
+        idle_cv_.wait(lock, [last] { return !last->busy; });
+        states_.pop_back();
+    }
+
+    // Grow: warm new states outside the lock so running scripts can still return theirs. Each state joins the
+    // pool busy before it is warmed, so a for_each broadcast (a binding, or a drop on plugin reload) that starts
+    // during the warm waits for it instead of skipping it and leaving it on the log's older contents.
+    while (states_.size() < count) {
+        auto owned = make_state(size_class_allocator_);
+        PooledState* state = owned.get();
+        state->index = states_.size();
+        state->busy = true;
+        states_.push_back(std::move(owned));
+        lock.unlock();
+
+        if (warm) {
+            try {
+                warm(*state);
+            } catch (const std::exception& e) {
+                std::cerr << "[LuaStatePool] Exception warming state " << state->index << ": " << e.what() << "\n";
+            }
+        }
+
+        lock.lock();
+        state->busy = false;
+        idle_cv_.notify_all();
+    }
+
+    std::cout << "[LuaStatePool] Pool size: " << states_.size() << "\n";
+    idle_cv_.notify_all();
+}
+
+LuaStatePool::Lease LuaStatePool::acquire()
+{
+    std::unique_lock lock(mutex_);
+    PooledState* found = nullptr;
+    idle_cv_.wait(lock, [&] {
+        for (const auto& state : states_) {
+            if (!state->busy) {
+                found = state.get();
+                return true;
+            }
+        }
+        return false;
+    });
+    found->busy = true;
+    return Lease(this, found);
+}
+
+LuaStatePool::Lease LuaStatePool::try_acquire()
+{
+    std::lock_guard lock(mutex_);
+    for (const auto& state : states_) {
+        if (!state->busy) {
+            state->busy = true;
+            return Lease(this, state.get());
+        }
+    }
+    return {};
+}
+
+void LuaStatePool::for_each(const StateHook& fn)
+{
+    std::unique_lock lock(mutex_);
+    for (std::size_t i = 0; i < states_.size(); ++i) {
+        PooledState* state = states_[i].get();
+        idle_cv_.wait(lock, [state] { return !state->busy; });
+        state->busy = true;
+        lock.unlock();
+
+        try {
+            fn(*state);
+        } catch (const std::exception& e) {
+            std::cerr << "[LuaStatePool] Exception applying update to state " << state->index << ": " << e.what() << "\n";
+        }
+
+        lock.lock();
+        state->busy = false;
+        idle_cv_.notify_all();
+    }
+}
+
+std::size_t LuaStatePool::size() const
+{
+    std::lock_guard lock(mutex_);
+    return states_.size();
+}
+
+std::size_t LuaStatePool::idle_count() const
+{
+    std::lock_guard lock(mutex_);
+    std::size_t idle = 0;
+    for (const auto& state : states_) {
+        if (!state->busy) {
+            ++idle;
+        }
+    }
+    return idle;
+}
+
+std::vector<LuaStatePool::StateMemory> LuaStatePool::memory_stats() const
+{
+    std::lock_guard lock(mutex_);
+    std::vector<StateMemory> out;
+    for (const auto& state : states_) {
+        out.push_back({state->index, state->allocator ? state->allocator->stats() : LuaAllocator::Stats{}, state->frame.stats()});
+    }
+    return out;
+}
+
+void LuaStatePool::give_back(PooledState* state)
+{
+    {
+        std::lock_guard lock(mutex_);
+        state->busy = false;
+    }
+    idle_cv_.notify_all();
+}
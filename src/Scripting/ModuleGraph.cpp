@@ -0,0 +1,159 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/ModuleGraph.cpp
+#include "Scripting/ModuleGraph.h"
+
+#include <mutex>
+
+#include "Scripting/BytecodeCache.h"
+
+namespace fs = std::filesystem;
+
+fs::path ModuleGraph::normalise(const fs::path& path)
+{
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path, ec);
+    return (ec ? path : absolute).lexically_normal();
+}
+
+// Hash of the file as it is now, 0 when it cannot be read
+static std::uint64_t hash_file(const fs::path& file)
+{
+    auto source = BytecodeCache::read_file(file);
+    return source ? BytecodeCache::hash_content(*source) : 0;
+}
+
+bool ModuleGraph::record(const fs::path& requirer, const std::string& name, const fs::path& module_file)
+{
+    {
+        // Fast path: modules are required far more often than new edges appear
+        std::shared_lock lock(mutex_);
+        auto it = modules_.find(module_file);
+        if (it != modules_.end() && it->second.names.contains(name) &&
+            (requirer.empty() || it->second.dependents.contains(requirer))) {
+            return false;
+        }
+    }
+
+    const std::uint64_t hash = hash_file(module_file);
+    std::unique_lock lock(mutex_);
+    auto [it, inserted] = modules_.try_emplace(module_file);
+    if (inserted) {
+        it->second.source_hash = hash;
+    }
+    it->second.names.insert(name);
+    names_[name] = module_file;
+    if (!requirer.empty() && requirer != module_file) {
+        it->second.dependents.insert(requirer);
+    }
+    return inserted;
+}
+
+std::optional<fs::path> ModuleGraph::file_for(const std::string& name) const
+{
+    std::shared_lock lock(mutex_);
+    auto it = names_.find(name);
+    if (it == names_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+bool ModuleGraph::is_module(const fs::path& file) const
+{
+    std::shared_lock lock(mutex_);
+    return modules_.contains(file);
+}
+
+std::vector<fs::path> ModuleGraph::dependents_of(const fs::path& file) const
+{
+    std::shared_lock lock(mutex_);
+    std::vector<fs::path> out;
+    std::unordered_set<fs::path> seen{file};
+    std::vector<fs::path> frontier{file};
+    while (!frontier.empty()) {
+        const fs::path current = std::move(frontier.back());
+        frontier.pop_back();
+        auto it = modules_.find(current);
+        if (it == modules_.end()) {
+            continue; // A top-level script, nothing requires it
+        }
+        for (const auto& dependent : it->second.dependents) {
+            if (seen.insert(dependent).second) {
+                out.push_back(dependent);
+                frontier.push_back(dependent);
+            }
+        }
+    }
+    return out;
+}
+
+std::vector<std::string> ModuleGraph::invalidate(const std::vector<fs::path>& changed_files)
+{
+    // Hash outside the lock, a save that rewrote the same bytes invalidates nothing
+    std::vector<std::pair<fs::path, std::uint64_t>> changed;
+    for (const auto& file : changed_files) {
+        changed.emplace_back(file, hash_file(file));
+    }
+
+    std::vector<fs::path> roots;
+    {
+        std::unique_lock lock(mutex_);
+        for (const auto& [file, hash] : changed) {
+            auto it = modules_.find(file);
+            if (it != modules_.end() && it->second.source_hash != hash) {
+                it->second.source_hash = hash;
+                roots.push_back(file);
+            }
+        }
+    }
+    if (roots.empty()) {
+        return {};
+    }
+
+    std::unordered_set<fs::path> affected(roots.begin(), roots.end());
+    for (const auto& root : roots) {
+        for (auto& dependent : dependents_of(root)) {
+            affected.insert(std::move(dependent));
+        }
+    }
+
+    Invalidation invalidation;
+    std::unique_lock lock(mutex_);
+    for (const auto& file : affected) {
+        auto it = modules_.find(file);
+        if (it != modules_.end()) {
+            invalidation.names.insert(invalidation.names.end(), it->second.names.begin(), it->second.names.end());
+        }
+    }
+    invalidation.epoch = epoch_ + 1;
+    history_.push_back(invalidation);
+    if (history_.size() > max_history) {
+        history_.pop_front();
+    }
+    epoch_ = invalidation.epoch;
+    return invalidation.names;
+}
+
+std::vector<std::string> ModuleGraph::invalidated_since(const std::uint64_t since) const
+{
+    std::shared_lock lock(mutex_);
+    std::vector<std::string> names;
+    if (since >= epoch_) {
+        return names;
+    }
+
+    if (history_.empty() || history_.front().epoch > since + 1) {
+        // Too far behind to replay, drop everything the graph knows about
+        for (const auto& [name, file] : names_) {
+            names.push_back(name);
+        }
+        return names;
+    }
+    for (const Invalidation& invalidation : history_) {
+        if (invalidation.epoch > since) {
+            names.insert(names.end(), invalidation.names.begin(), invalidation.names.end());
+        }
+    }
+    return names;
+}
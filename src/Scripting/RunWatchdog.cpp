@@ -0,0 +1,77 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/RunWatchdog.cpp
+#include "Scripting/RunWatchdog.h"
+
+#include <algorithm>
+
+#include <lua.hpp>
+
+// A state only runs on the thread that leased it, so the hook finds its watchdog here
+static thread_local RunWatchdog* current_watchdog = nullptr;
+
+static constexpr int default_interval = 1000;
+
+RunWatchdog::RunWatchdog(lua_State* L, const RunLimits& limits) : L_(L), limits_(limits)
+{
+    if (!limits_.enabled()) {
+        return;
+    }
+
+    interval_ = default_interval;
+    if (limits_.max_instructions > 0) {
+        interval_ = static_cast<int>(std::min<std::uint64_t>(limits_.max_instructions, default_interval));
+    }
+    if (limits_.deadline.count() > 0) {
+        deadline_at_ = std::chrono::steady_clock::now() + limits_.deadline;
+    }
+
+    previous_ = current_watchdog;
+    current_watchdog = this;
+    lua_sethook(L_, &RunWatchdog::hook, LUA_MASKCOUNT, interval_);
+}
+
+RunWatchdog::~RunWatchdog()
+{
+    if (interval_ == 0) {
+        return;
+    }
+    lua_sethook(L_, nullptr, 0, 0);
+    current_watchdog = previous_;
+}
+
+std::string RunWatchdog::describe() const
+{
+    switch (verdict_) {
+    case Verdict::INSTRUCTION_BUDGET:
+        return "aborted: instruction budget of " + std::to_string(limits_.max_instructions) + " exceeded";
+    case Verdict::DEADLINE:
+        return "aborted: deadline of " + std::to_string(limits_.deadline.count()) + " ms exceeded";
+    default:
+        return {};
+    }
+}
+
+// Raises a Lua error, so nothing with a destructor may be alive here
+void RunWatchdog::hook(lua_State* L, lua_Debug* ar)
+{
+    RunWatchdog* self = current_watchdog;
+    if (!self || ar->event != LUA_HOOKCOUNT) {
+        return;
+    }
+
+    if (self->verdict_ == Verdict::NONE) {
+        self->instructions_ += static_cast<std::uint64_t>(self->interval_);
+        if (self->limits_.max_instructions > 0 && self->instructions_ >= self->limits_.max_instructions) {
+            self->verdict_ = Verdict::INSTRUCTION_BUDGET;
+        } else if (self->limits_.deadline.count() > 0 && std::chrono::steady_clock::now() >= self->deadline_at_) {
+            self->verdict_ = Verdict::DEADLINE;
+        } else {
+            return;
+        }
+        // From here on, fire on every instruction so pcall cannot swallow the abort
+        lua_sethook(L, &RunWatchdog::hook, LUA_MASKCOUNT, 1);
+    }
+
+    luaL_error(L, "%s", self->verdict_ == Verdict::DEADLINE ? "deadline exceeded" : "instruction budget exceeded");
+}
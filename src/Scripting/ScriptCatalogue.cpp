@@ -0,0 +1,123 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/ScriptCatalogue.cpp
+#include "Scripting/ScriptCatalogue.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "Scripting/BytecodeCache.h"
+
+namespace fs = std::filesystem;
+
+std::expected<ScriptCatalogue::Entry, std::string> ScriptCatalogue::index(const fs::path& path)
+{
+    auto source = BytecodeCache::read_file(path);
+    if (!source) {
+        return std::unexpected(source.error());
+    }
+
+    Entry entry;
+    entry.path = path;
+    entry.size = source->size();
+    entry.source_hash = BytecodeCache::hash_content(*source);
+    std::error_code ec;
+    entry.last_write = fs::last_write_time(path, ec);
+
+    std::lock_guard lock(mutex_);
+    auto [it, inserted] = entries_.try_emplace(path, entry);
+    if (!inserted) {
+        entry.runs = it->second.runs;
+        it->second = entry;
+    }
+    return entry;
+}
+
+std::size_t ScriptCatalogue::index_directory(const fs::path& dir)
+{
+    std::size_t added = 0;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_regular_file() || it->path().extension() != ".lua") {
+            continue;
+        }
+        if (auto entry = index(it->path())) {
+            added++;
+        } else {
+            std::cerr << "[ScriptCatalogue] Skipping " << it->path() << ": " << entry.error() << "\n";
+        }
+    }
+    if (ec) {
+        std::cerr << "[ScriptCatalogue] Error scanning " << dir << ": " << ec.message() << "\n";
+    }
+    return added;
+}
+
+bool ScriptCatalogue::contains(const fs::path& path) const
+{
+    std::lock_guard lock(mutex_);
+    return entries_.contains(path);
+}
+
+std::optional<ScriptCatalogue::Entry> ScriptCatalogue::find(const fs::path& path) const
+{
+    std::lock_guard lock(mutex_);
+    auto it = entries_.find(path);
+    if (it == entries_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::vector<ScriptCatalogue::Entry> ScriptCatalogue::entries() const
+{
+    std::lock_guard lock(mutex_);
+    std::vector<Entry> out;
+    out.reserve(entries_.size());
+    for (const auto& [path, entry] : entries_) {
+        out.push_back(entry);
+    }
+    return out;
+}
+
+std::size_t ScriptCatalogue::size() const
+{
+    std::lock_guard lock(mutex_);
+    return entries_.size();
+}
+
+void ScriptCatalogue::record_run(const fs::path& path)
+{
+    std::lock_guard lock(mutex_);
+    if (auto it = entries_.find(path); it != entries_.end()) {
+        it->second.runs++;
+    }
+}
+
+void ScriptCatalogue::set_runs(const fs::path& path, const std::uint64_t runs)
+{
+    std::lock_guard lock(mutex_);
+    if (auto it = entries_.find(path); it != entries_.end()) {
+        it->second.runs = runs;
+    }
+}
+
+std::vector<fs::path> ScriptCatalogue::most_run(const std::size_t count) const
+{
+    std::vector<std::pair<std::uint64_t, fs::path>> ranked;
+    {
+        std::lock_guard lock(mutex_);
+        for (const auto& [path, entry] : entries_) {
+            if (entry.runs > 0) {
+                ranked.emplace_back(entry.runs, path);
+            }
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<fs::path> out;
+    for (std::size_t i = 0; i < ranked.size() && i < count; ++i) {
+        out.push_back(std::move(ranked[i].second));
+    }
+    return out;
+}
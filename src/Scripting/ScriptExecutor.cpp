@@ -0,0 +1,238 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/ScriptExecutor.cpp
+#include "Scripting/ScriptExecutor.h"
+
+#include <iostream>
+
+void ScriptExecutor::start(const std::size_t worker_count, Runner runner)
+{
+    std::vector<std::thread> retired;
+    {
+        std::lock_guard lock(mutex_);
+        if (workers_.empty()) {
+            runner_ = std::move(runner);
+        }
+        stopping_ = false;
+        target_workers_ = worker_count;
+
+        // Surplus workers notice target_workers_ dropped and exit on their own
+        while (workers_.size() > target_workers_) {
+            retired.push_back(std::move(workers_.back()));
+            workers_.pop_back();
+        }
+        while (workers_.size() < target_workers_) {
+            const std::size_t index = workers_.size();
+            workers_.emplace_back([this, index] { worker_loop(index); });
+        }
+    }
+    work_cv_.notify_all();
+    for (std::thread& worker : retired) {
+        worker.join();
+    }
+    std::cout << "[ScriptExecutor] Workers: " << worker_count << "\n";
+}
+
+void ScriptExecutor::stop()
+{
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+        target_workers_ = 0;
+        workers.swap(workers_);
+
+        for (const QueueKey& key : queue_) {
+            Job& job = jobs_[key.second];
+            job.result.status = JobStatus::CANCELLED;
+            job.result.error = "executor stopped";
+            retire(key.second);
+        }
+        queue_.clear();
+    }
+    work_cv_.notify_all();
+    done_cv_.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+std::expected<ScriptExecutor::JobId, ScriptExecutor::SubmitError>
+ScriptExecutor::submit(const std::filesystem::path& path, const JobPriority priority)
+{
+    JobRequest request;
+    request.path = path;
+    return submit(std::move(request), priority);
+}
+
+std::expected<ScriptExecutor::JobId, ScriptExecutor::SubmitError>
+ScriptExecutor::submit(JobRequest request, const JobPriority priority)
+{
+    JobId id;
+    {
+        std::lock_guard lock(mutex_);
+        if (stopping_ || target_workers_ == 0) {
+            return std::unexpected(SubmitError::EXECUTOR_STOPPED);
+        }
+        // Bounded queue: the caller is told instead of the request being dropped
+        if (queue_.size() >= queue_capacity_) {
+            std::cerr << "[ScriptExecutor] Queue full (" << queue_capacity_ << "), rejecting run of " << request.path << "\n";
+            return std::unexpected(SubmitError::QUEUE_FULL);
+        }
+
+        id = next_id_++;
+        Job job;
+        job.request = std::move(request);
+        job.priority = priority;
+        job.result.status = JobStatus::QUEUED;
+        jobs_.emplace(id, std::move(job));
+        queue_.emplace(-static_cast<int>(priority), id);
+    }
+    work_cv_.notify_one();
+    return id;
+}
+
+bool ScriptExecutor::cancel(const JobId id)
+{
+    {
+        std::lock_guard lock(mutex_);
+        auto it = jobs_.find(id);
+        if (it == jobs_.end() || it->second.result.status != JobStatus::QUEUED) {
+            return false;
+        }
+        queue_.erase({-static_cast<int>(it->second.priority), id});
+        it->second.result.status = JobStatus::CANCELLED;
+        it->second.result.error = "cancelled before start";
+        retire(id);
+    }
+    done_cv_.notify_all();
+    return true;
+}
+
+ScriptExecutor::JobStatus ScriptExecutor::status(const JobId id) const
+{
+    std::lock_guard lock(mutex_);
+    auto it = jobs_.find(id);
+    return it == jobs_.end() ? JobStatus::UNKNOWN : it->second.result.status;
+}
+
+std::optional<ScriptExecutor::JobResult> ScriptExecutor::result(const JobId id) const
+{
+    std::lock_guard lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end()) {
+        return std::nullopt;
+    }
+    const JobStatus state = it->second.result.status;
+    if (state == JobStatus::QUEUED || state == JobStatus::RUNNING) {
+        return std::nullopt;
+    }
+    return it->second.result;
+}
+
+ScriptExecutor::JobResult ScriptExecutor::wait(const JobId id)
+{
+    std::unique_lock lock(mutex_);
+    done_cv_.wait(lock, [&] {
+        auto it = jobs_.find(id);
+        if (it == jobs_.end()) {
+            return true;
+        }
+        const JobStatus state = it->second.result.status;
+        return state != JobStatus::QUEUED && state != JobStatus::RUNNING;
+    });
+    auto it = jobs_.find(id);
+    return it == jobs_.end() ? JobResult{} : it->second.result;
+}
+
+void ScriptExecutor::set_queue_capacity(const std::size_t capacity)
+{
+    std::lock_guard lock(mutex_);
+    queue_capacity_ = capacity;
+}
+
+std::size_t ScriptExecutor::queued_count() const
+{
+    std::lock_guard lock(mutex_);
+    return queue_.size();
+}
+
+std::size_t ScriptExecutor::worker_count() const
+{
+    std::lock_guard lock(mutex_);
+    return target_workers_;
+}
+
+std::string_view ScriptExecutor::to_string(const JobStatus status)
+{
+    switch (status) {
+    case JobStatus::QUEUED:    return "QUEUED";
+    case JobStatus::RUNNING:   return "RUNNING";
+    case JobStatus::SUCCEEDED: return "SUCCEEDED";
+    case JobStatus::FAILED:    return "FAILED";
+    case JobStatus::KILLED:    return "KILLED";
+    case JobStatus::CANCELLED: return "CANCELLED";
+    default:                   return "UNKNOWN";
+    }
+}
+
+std::string_view ScriptExecutor::to_string(const SubmitError error)
+{
+    switch (error) {
+    case SubmitError::QUEUE_FULL:        return "QUEUE_FULL";
+    case SubmitError::SCRIPT_NOT_LOADED: return "SCRIPT_NOT_LOADED";
+    case SubmitError::EXECUTOR_STOPPED:  return "EXECUTOR_STOPPED";
+    default:                             return "UNKNOWN";
+    }
+}
+
+void ScriptExecutor::worker_loop(const std::size_t index)
+{
+    while (true) {
+        JobId id;
+        JobRequest request;
+        {
+            std::unique_lock lock(mutex_);
+            work_cv_.wait(lock, [&] { return index >= target_workers_ || !queue_.empty(); });
+            if (index >= target_workers_) {
+                return;
+            }
+            id = queue_.begin()->second;
+            queue_.erase(queue_.begin());
+            Job& job = jobs_[id];
+            job.result.status = JobStatus::RUNNING;
+            request = std::move(job.request); // Nothing reads it once dequeued, and a batch's records are large
+        }
+
+        JobResult result;
+        try {
+            result = runner_(request);
+        } catch (const std::exception& e) {
+            result.status = JobStatus::FAILED;
+            result.error = e.what();
+        }
+        finish(id, std::move(result));
+    }
+}
+
+void ScriptExecutor::finish(const JobId id, JobResult result)
+{
+    {
+        std::lock_guard lock(mutex_);
+        jobs_[id].result = std::move(result);
+        retire(id);
+    }
+    done_cv_.notify_all();
+}
+
+void ScriptExecutor::retire(const JobId id)
+{
+    jobs_[id].request = JobRequest();
+    finished_order_.push_back(id);
+
+    // Bounded result history so a long-running engine does not grow without limit
+    while (finished_order_.size() > result_history_) {
+        jobs_.erase(finished_order_.front());
+        finished_order_.pop_front();
+    }
+}
@@ -5,11 +5,17 @@
 
 #include <chrono>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <string_view>
+#include <utility>
 #include <fstream> // For std::ifstream and std::ofstream
 #include <iomanip> // For std::setw
 #include <nlohmann/json.hpp> // For JSON config serialization
 #include <future> // For std::async and std::future
+#include <algorithm> // For std::max
+#include <array>
+#include <span>
 
 namespace fs = std::filesystem; // Alias for std::filesystem
 std::string FileTimeTypeToString(const std::filesystem::file_time_type& ftime) {
@@ -33,11 +39,20 @@ std::string FileTimeTypeToString(const std::filesystem::file_time_type& ftime) {
 }
 
 
-ScriptManager::SMInitResult ScriptManager::init()
+void ScriptManager::open_state_libraries(sol::state& lua)
+{
+    lua.open_libraries(sol::lib::base, sol::lib::package); // Load basic Lua libraries
+}
+
+ScriptManager::SMInitResult ScriptManager::init(const std::size_t pool_size)
 {
     try
     {
-        lua_.open_libraries(sol::lib::base, sol::lib::package); // Load basic Lua libraries
+        open_state_libraries(lua_);
+        install_module_tracking(lua_);
+        engine_.start(); // From here on lua_ is only touched on the engine thread
+        compile_service_.start();
+        set_pool_size(pool_size);
     } catch (const std::exception& e)
     {
         std::cout << "init failed: " << e.what() << std::endl;
@@ -46,38 +61,511 @@ ScriptManager::SMInitResult ScriptManager::init()
     return SMInitResult::SUCCESS;
 };
 
+void ScriptManager::set_pool_size(std::size_t pool_size)
+{
+    if (pool_size == 0) {
+        pool_size = std::max(1u, std::thread::hardware_concurrency());
+    }
+    pool_.resize(pool_size, [this](LuaStatePool::PooledState& state) { warm_state(state); });
+
+    // One worker per pooled state, so a dequeued job never waits on a lease
+    executor_.start(pool_size, [this](const JobRequest& request) { return execute_on_pool(request); });
+}
+
+void ScriptManager::prepare_fork()
+{
+    stopped_for_fork_ = {watcher_.running(), scheduler_.running(), ticker_.running()};
+    stop_workers();
+
+    // Installing chunks needs no compiling, only the registry snapshot, so this can follow the executor.
+    // A full collect first means children do not dirty shared pages marking garbage the parent left behind.
+    pool_.for_each([this](LuaStatePool::PooledState& state) {
+        sync_state(state);
+        state.lua.collect_garbage();
+    });
+
+    compile_workers_before_fork_ = compile_service_.worker_count();
+    compile_service_.stop();
+    engine_.stop();
+    std::cout << "[ScriptManager] Quiesced for fork, " << pool_.size() << " warm states\n";
+}
+
+void ScriptManager::resume_after_fork(const ForkSide side)
+{
+    engine_.start();
+    compile_service_.start(compile_workers_before_fork_);
+    executor_.start(pool_.size(), [this](const JobRequest& request) { return execute_on_pool(request); });
+
+    // A child must not watch files or run ticks on its own; the parent picks up where it left off, minus the
+    // coroutine tasks and ticks prepare_fork() dropped
+    const StoppedForFork stopped = std::exchange(stopped_for_fork_, {});
+    if (side == ForkSide::CHILD) {
+        return;
+    }
+    if (stopped.scheduler) {
+        start_scheduler(scheduler_budget_);
+    }
+    if (stopped.ticker) {
+        start_tick_executor(tick_priority_);
+    }
+    if (stopped.watcher) {
+        start_watcher_thread(watcher_debounce_);
+    }
+}
+
+void ScriptManager::stop_workers()
+{
+    stop_watcher_thread();
+    ticker_.stop();
+    scheduler_.stop();
+    executor_.stop();
+}
+
+ScriptManager::~ScriptManager()
+{
+    stop_workers();
+    compile_service_.stop();
+    engine_.stop();
+}
+
+void ScriptManager::start_scheduler(const int instruction_budget)
+{
+    scheduler_budget_ = instruction_budget;
+    scheduler_.start([this](LuaStatePool::PooledState& state) { warm_state(state); }, instruction_budget, size_class_allocator_);
+}
+
+void ScriptManager::start_tick_executor(const int realtime_priority)
+{
+    tick_priority_ = realtime_priority;
+    ticker_.start([this](LuaStatePool::PooledState& state) {
+        warm_state(state);
+        state.index = tick_state_index;
+    }, [this](LuaStatePool::PooledState& state, const JobRequest& request, JobResult& result) {
+        execute_on_state(state, request, result);
+    },
+    size_class_allocator_, realtime_priority);
+}
+
+std::expected<TickExecutor::TickId, std::string> ScriptManager::schedule_tick(const fs::path& path,
+                                                                              const std::chrono::microseconds period,
+                                                                              const std::string& entry)
+{
+    if (!is_loaded(path) && catalogue_.contains(path) && !compile_on_demand(path).get()) {
+        return std::unexpected("script failed to compile");
+    }
+    if (!is_loaded(path)) {
+        std::cerr << "Script not loaded: " << path << "\n";
+        return std::unexpected("script not loaded");
+    }
+    return ticker_.add(path, period, entry);
+}
+
+std::expected<CoroutineScheduler::TaskId, std::string> ScriptManager::spawn_task(const fs::path& path)
+{
+    if (!is_loaded(path) && catalogue_.contains(path) && !compile_on_demand(path).get()) {
+        return std::unexpected("script failed to compile");
+    }
+    if (!is_loaded(path)) {
+        std::cerr << "Script not loaded: " << path << "\n";
+        return std::unexpected("script not loaded");
+    }
+    return scheduler_.spawn(path);
+}
+
+std::vector<CoroutineScheduler::TaskId> ScriptManager::spawn_loaded_scripts()
+{
+    std::vector<CoroutineScheduler::TaskId> ids;
+    for (const auto& [path, entry] : registry_.snapshot()->scripts) {
+        if (auto id = scheduler_.spawn(path)) {
+            ids.push_back(*id);
+        }
+    }
+    return ids;
+}
+
+void ScriptManager::warm_state(LuaStatePool::PooledState& state)
+{
+    open_state_libraries(state.lua);
+    install_module_tracking(state.lua);
+    FrameArena::register_api(state.lua);
+
+    {
+        std::lock_guard lock(bindings_mutex_);
+        for (const OwnedBinding& binding : binding_log_) {
+            binding.apply(state.lua);
+        }
+    }
+
+    sync_state(state);
+}
+
+void ScriptManager::sync_state(LuaStatePool::PooledState& state)
+{
+    // Lock-free check first, the snapshot load is only paid after a publish
+    if (state.synced_generation == registry_.generation()) {
+        return; // Nothing published since the last sync
+    }
+    // Stays valid for this call even if a reload publishes meanwhile
+    const ScriptRegistry::SnapshotPtr snapshot = registry_.snapshot();
+    if (state.synced_generation == snapshot->generation) {
+        return;
+    }
+
+    for (const auto& [path, entry] : snapshot->scripts) {
+        auto installed = state.chunk_versions.find(path);
+        if (installed != state.chunk_versions.end() && installed->second == entry.version) {
+            continue;
+        }
+        if (load_pooled_chunk(state, path, entry.bytecode, isolated_globals_)) {
+            state.chunk_versions[path] = entry.version;
+        }
+    }
+
+    // Drop chunks for scripts that are no longer registered
+    std::erase_if(state.chunks, [&](const auto& chunk) { return !snapshot->scripts.contains(chunk.first); });
+    std::erase_if(state.chunk_versions, [&](const auto& version) { return !snapshot->scripts.contains(version.first); });
+    std::erase_if(state.environments, [&](const auto& environment) { return !snapshot->scripts.contains(environment.first); });
+    std::erase_if(state.entry_points, [&](const auto& entries) { return !snapshot->scripts.contains(entries.first); });
+
+    state.synced_generation = snapshot->generation;
+}
+
+void ScriptManager::publish_chunks(std::vector<std::pair<fs::path, ScriptRegistry::Entry>> entries)
+{
+    if (entries.empty()) {
+        return;
+    }
+
+    // One copy and one atomic swap for the whole batch
+    registry_.update([&entries](ScriptRegistry::Snapshot& next, const std::uint64_t generation) {
+        for (auto& [path, entry] : entries) {
+            entry.version = generation;
+            next.scripts[path] = std::move(entry);
+        }
+    });
+
+    // The scheduler's state syncs between slices, pooled states sync when they are next leased
+    scheduler_.post([this](LuaStatePool::PooledState& state) { sync_state(state); });
+}
+
+ScriptRegistry::Entry ScriptManager::make_entry(const fs::path& path, const BytecodeCache::CompiledChunk& chunk)
+{
+    ScriptRegistry::Entry entry;
+    entry.bytecode = chunk.bytecode;
+    entry.source_hash = chunk.source_hash;
+    std::error_code ec;
+    entry.last_write = fs::last_write_time(path, ec);
+    return entry;
+}
+
+bool ScriptManager::is_loaded(const fs::path& path) const
+{
+    return registry_.contains(path);
+}
+
+std::shared_future<bool> ScriptManager::compile_on_demand(const fs::path& path)
+{
+    auto done = std::make_shared<std::promise<bool>>();
+    std::shared_future<bool> published = done->get_future().share();
+    {
+        std::lock_guard lock(on_demand_mutex_);
+        if (auto in_flight = on_demand_.find(path); in_flight != on_demand_.end()) {
+            return in_flight->second;
+        }
+        if (is_loaded(path)) {
+            done->set_value(true);
+            return published;
+        }
+        on_demand_.emplace(path, published);
+    }
+
+    // Submitted outside the lock: a stopped service completes inline
+    compile_service_.submit(path, [this, done](CompileService::CompileResult result) {
+        const bool compiled = result.chunk.has_value();
+        if (compiled) {
+            std::vector<std::pair<fs::path, ScriptRegistry::Entry>> entries;
+            entries.emplace_back(result.path, make_entry(result.path, *result.chunk));
+            publish_chunks(std::move(entries));
+            watcher_.watch(result.path);
+        } else {
+            std::cerr << "Lua load error in " << result.path << ": " << result.chunk.error() << "\n";
+        }
+
+        // A failed compile is forgotten so the next run retries, e.g. after the file is fixed
+        {
+            std::lock_guard lock(on_demand_mutex_);
+            on_demand_.erase(result.path);
+        }
+        done->set_value(compiled);
+    });
+    return published;
+}
+
+ScriptManager::SMLoadResult ScriptManager::catalogue_script(const fs::path& path)
+{
+    if (is_loaded(path) || catalogue_.contains(path)) {
+        return SMLoadResult::FILE_ALREADY_LOADED;
+    }
+    if (auto entry = catalogue_.index(path); !entry) {
+        std::cerr << "Failed to catalogue " << path << ": " << entry.error() << "\n";
+        return SMLoadResult::FILE_LOAD_ERROR;
+    }
+    return SMLoadResult::FILE_LOAD_SUCCESS;
+}
+
+void ScriptManager::prefetch_scripts(const std::vector<fs::path>& paths)
+{
+    for (const auto& path : paths) {
+        if (!is_loaded(path) && catalogue_.contains(path)) {
+            compile_on_demand(path); // Nobody waits, the completion publishes it
+        }
+    }
+}
+
+sol::load_result ScriptManager::load_bytecode(sol::state& lua, const fs::path& path, const std::string& bytecode)
+{
+    return lua.load(std::string_view(bytecode), BytecodeCache::chunk_name_for(path), sol::load_mode::binary);
+}
+
+bool ScriptManager::load_pooled_chunk(LuaStatePool::PooledState& state, const fs::path& path,
+                                      const std::shared_ptr<const std::string>& bytecode, const bool isolate)
+{
+    sol::load_result script = load_bytecode(state.lua, path, *bytecode);
+    if (!script.valid()) {
+        const sol::error err = script;
+        std::cerr << "Lua load error in " << path << " (pooled state " << state.index << "): " << err.what() << "\n";
+        return false;
+    }
+    sol::protected_function chunk = script.get<sol::protected_function>();
+    if (isolate) {
+        // A reloaded chunk gets the environment of the version it replaces, so script state survives the reload
+        sol::set_environment(script_environment(state, path), chunk);
+    }
+    state.chunks.insert_or_assign(path, std::move(chunk));
+    return true;
+}
+
+// Read-only views of shared tables. Every view closure carries the environment's view cache as upvalue 1 (a
+// weak-keyed table of shared table -> view, so each table has one view per script) and the table it reads as
+// upvalue 2. A write through a view raises; rawset on a view only touches that script's own empty view table.
+static void push_read_only_view(lua_State* L, int index);
+
+static int read_only_view_index(lua_State* L)
+{
+    lua_pushvalue(L, 2);
+    if (lua_gettable(L, lua_upvalueindex(2)) == LUA_TTABLE) {
+        push_read_only_view(L, -1);
+    }
+    return 1;
+}
+
+static int read_only_view_new_index(lua_State* L)
+{
+    return luaL_error(L, "attempt to modify shared table field '%s'", luaL_tolstring(L, 2, nullptr));
+}
+
+static int read_only_view_next(lua_State* L)
+{
+    lua_settop(L, 2);
+    if (lua_next(L, lua_upvalueindex(2)) == 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+    if (lua_type(L, -1) == LUA_TTABLE) {
+        push_read_only_view(L, -1);
+        lua_replace(L, -2);
+    }
+    return 2;
+}
+
+static int read_only_view_pairs(lua_State* L)
+{
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_pushvalue(L, lua_upvalueindex(2));
+    lua_pushcclosure(L, read_only_view_next, 2);
+    lua_pushvalue(L, 1);
+    lua_pushnil(L);
+    return 3;
+}
+
+static int read_only_view_len(lua_State* L)
+{
+    lua_len(L, lua_upvalueindex(2));
+    return 1;
+}
+
+static void push_read_only_view(lua_State* L, int index)
+{
+    index = lua_absindex(L, index);
+    lua_pushvalue(L, index);
+    if (lua_rawget(L, lua_upvalueindex(1)) != LUA_TNIL) {
+        return;
+    }
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, 0);
+    lua_createtable(L, 0, 5);
+    const auto set_method = [L, index](const char* name, const lua_CFunction method) {
+        lua_pushvalue(L, lua_upvalueindex(1));
+        lua_pushvalue(L, index);
+        lua_pushcclosure(L, method, 2);
+        lua_setfield(L, -2, name);
+    };
+    set_method("__index", read_only_view_index);
+    set_method("__newindex", read_only_view_new_index);
+    set_method("__pairs", read_only_view_pairs);
+    set_method("__len", read_only_view_len);
+    lua_pushboolean(L, 0);
+    lua_setfield(L, -2, "__metatable");
+    lua_setmetatable(L, -2);
+
+    lua_pushvalue(L, index);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, lua_upvalueindex(1));
+}
+
+sol::environment& ScriptManager::script_environment(LuaStatePool::PooledState& state, const fs::path& path)
+{
+    auto it = state.environments.find(path);
+    if (it != state.environments.end()) {
+        return it->second;
+    }
+
+    // Lookups that miss fall through to the state's globals, and tables found there (library and plugin namespaces,
+    // plugin.lua modules) come back as read-only views, so one script cannot rewrite what the others see. The
+    // metatable is hidden so a script cannot reach the shared table through getmetatable(_ENV).
+    lua_State* L = state.lua.lua_state();
+    sol::environment environment(state.lua, sol::create);
+    environment.push(L);
+    lua_createtable(L, 0, 2);
+    lua_createtable(L, 0, 0);
+    lua_createtable(L, 0, 1);
+    lua_pushliteral(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_pushglobaltable(L);
+    lua_pushcclosure(L, read_only_view_index, 2);
+    lua_setfield(L, -2, "__index");
+    lua_pushboolean(L, 0);
+    lua_setfield(L, -2, "__metatable");
+    lua_setmetatable(L, -2);
+    lua_pop(L, 1);
+    environment["_G"] = environment;
+
+    // package.loaded._G is the shared globals table itself; scripts reach their own _G through the environment
+    lua_getfield(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+    lua_pushnil(L);
+    lua_setfield(L, -2, "_G");
+    lua_pop(L, 1);
+    return state.environments.emplace(path, std::move(environment)).first->second;
+}
+
+void ScriptManager::apply_binding(OwnedBinding binding)
+{
+    StateBinding apply = binding.apply;
+    {
+        std::lock_guard lock(bindings_mutex_);
+        auto same = std::find_if(binding_log_.begin(), binding_log_.end(), [&binding](const OwnedBinding& logged) {
+            return logged.ns == binding.ns && logged.name == binding.name;
+        });
+        if (same != binding_log_.end()) {
+            *same = std::move(binding);
+        } else {
+            binding_log_.push_back(std::move(binding));
+        }
+    }
+    broadcast_binding(apply);
+}
+
+std::size_t ScriptManager::drop_bindings(const std::string& owner)
+{
+    std::vector<OwnedBinding> dropped;
+    {
+        std::lock_guard lock(bindings_mutex_);
+        auto kept = std::stable_partition(binding_log_.begin(), binding_log_.end(), [&owner](const OwnedBinding& logged) {
+            return logged.owner != owner;
+        });
+        std::move(kept, binding_log_.end(), std::back_inserter(dropped));
+        binding_log_.erase(kept, binding_log_.end());
+    }
+    if (dropped.empty()) {
+        return 0;
+    }
+
+    std::vector<std::pair<std::string, std::string>> names;
+    for (const OwnedBinding& binding : dropped) {
+        names.emplace_back(binding.ns, binding.name);
+    }
+    broadcast_binding([names](sol::state_view lua) {
+        for (const auto& [ns, name] : names) {
+            if (ns.empty()) {
+                lua[name] = sol::lua_nil;
+            } else if (sol::optional<sol::table> table = lua[ns]; table) {
+                (*table)[name] = sol::lua_nil;
+            }
+        }
+    }, true);
+    std::cout << "[ScriptManager] Dropped " << names.size() << " bindings owned by " << owner << "\n";
+    return names.size();
+}
+
+void ScriptManager::broadcast_binding(const StateBinding& binding, const bool wait_for_all)
+{
+    // Waits, so the binding is visible in the primary state by the time the caller moves on
+    engine_.call([&binding](sol::state& lua) { binding(lua); }).get();
+    pool_.for_each([&binding](LuaStatePool::PooledState& state) { binding(state.lua); });
+    if (!wait_for_all) {
+        scheduler_.post([binding](LuaStatePool::PooledState& state) { binding(state.lua); });
+        ticker_.post([binding](LuaStatePool::PooledState& state) { binding(state.lua); });
+        return;
+    }
+
+    // The promise breaks if a thread stops, or was not running, and discards the update unapplied. Either way its
+    // state runs nothing further, so both outcomes end the wait.
+    const auto post_and_wait = [&binding](auto& worker) {
+        auto applied = std::make_shared<std::promise<void>>();
+        std::future<void> done = applied->get_future();
+        worker.post([binding, applied](LuaStatePool::PooledState& state) {
+            binding(state.lua);
+            applied->set_value();
+        });
+        return done;
+    };
+    std::future<void> scheduler_done = post_and_wait(scheduler_);
+    std::future<void> ticker_done = post_and_wait(ticker_);
+    scheduler_done.wait();
+    ticker_done.wait();
+}
+
 // Loads a Lua script from the given path and keeps it ready to run
 ScriptManager::SMLoadResult ScriptManager::load_script(const fs::path& path)
 {
     // Check early if script is already loaded
-    if (loaded_scripts_.contains(path)) {
+    if (is_loaded(path)) {
         return SMLoadResult::FILE_ALREADY_LOADED;  // Already loaded
     }
 
     try {
-        sol::load_result script = lua_.load_file(path.string());
+        auto compiled = bytecode_cache_.fetch(path);
 
         // Check for load errors
-        if (!script.valid()) {
-            const sol::error err = script;
-            std::cerr << "Lua load error in " << path << ": " << err.what() << "\n";
+        if (!compiled) {
+            std::cerr << "Lua load error in " << path << ": " << compiled.error() << "\n";
             return SMLoadResult::FILE_LOAD_ERROR;
         }
 
-        // we take the path of the script, and the script, and shove it up the ass of the class
-        loaded_scripts_.emplace(path, std::move(script));
-
-        try {
-            auto last_write = std::filesystem::last_write_time(path);
-            file_watch_times_.insert({path, last_write});
-            std::cout << "last write at: " << last_write;
-        } catch (const std::filesystem::filesystem_error& e) {
-            std::cerr << "Filesystem error for " << path << ": " << e.what() << "\n";
+        // note the watch time, if this changes we reload, because it has been modified.
+        ScriptRegistry::Entry entry = make_entry(path, *compiled);
+        if (entry.last_write == fs::file_time_type{}) {
+            std::cerr << "Filesystem error for " << path << ": cannot read modification time\n";
             return SMLoadResult::FILE_LOAD_ERROR;
         }
 
-        // note the watch time, if this changes we reload, because it has been modified.
-
+        // we take the path of the script, and the script, and shove it up the ass of the class
+        std::vector<std::pair<fs::path, ScriptRegistry::Entry>> entries;
+        entries.emplace_back(path, std::move(entry));
+        publish_chunks(std::move(entries));
+        watcher_.watch(path);
 
         return SMLoadResult::FILE_LOAD_SUCCESS;
 
@@ -88,33 +576,419 @@ ScriptManager::SMLoadResult ScriptManager::load_script(const fs::path& path)
 }
 
 
-// Executes a loaded script by its path (only one runs at a time)
-std::future<void> ScriptManager::run_script(const fs::path& path)
+// Queues a loaded script for execution on a pooled state, higher priorities run first
+std::expected<ScriptManager::JobId, ScriptExecutor::SubmitError>
+ScriptManager::run_script(const fs::path& path, const JobPriority priority)
 {
-    if (Exec_running) {
-        std::cerr << "A script is already running. Only one script can run at a time.\n";
-        return std::future<void>(); // Return an invalid future
+    if (!is_loaded(path) && !catalogue_.contains(path)) {
+        std::cerr << "Script not loaded: " << path << "\n";
+        return std::unexpected(ScriptExecutor::SubmitError::SCRIPT_NOT_LOADED);
     }
 
-    auto it = loaded_scripts_.find(path);
-    if (it == loaded_scripts_.end()) {
+    auto job = executor_.submit(path, priority);
+    if (job) {
+        catalogue_.record_run(path);
+    }
+    return job;
+}
+
+std::expected<ScriptManager::JobId, ScriptExecutor::SubmitError>
+ScriptManager::call_entry_batch(const fs::path& path, const std::string& entry, json records, const JobPriority priority)
+{
+    if (!is_loaded(path) && !catalogue_.contains(path)) {
         std::cerr << "Script not loaded: " << path << "\n";
-        return std::future<void>(); // Return an invalid future
-    }
-
-    Exec_running = true;
-    // Capture the sol::load_result by value to ensure it's valid in the new thread
-    return std::async(std::launch::async, [this, path]() {
-        auto it = loaded_scripts_.find(path);
-        if (it != loaded_scripts_.end()) {
-            sol::protected_function_result result = it->second();
-            if (!result.valid()) {
-                sol::error err = result;
-                std::cerr << "Lua script execution error: " << err.what() << "\n";
+        return std::unexpected(ScriptExecutor::SubmitError::SCRIPT_NOT_LOADED);
+    }
+    if (!records.is_array()) {
+        records = json::array({std::move(records)});
+    }
+
+    JobRequest request;
+    request.path = path;
+    request.entry = entry;
+    request.args = std::move(records);
+    request.batch = true;
+    auto job = executor_.submit(std::move(request), priority);
+    if (job) {
+        catalogue_.record_run(path);
+    }
+    return job;
+}
+
+std::expected<ScriptManager::JobId, ScriptExecutor::SubmitError>
+ScriptManager::call_entry(const fs::path& path, const std::string& entry, json args, const JobPriority priority)
+{
+    if (!is_loaded(path) && !catalogue_.contains(path)) {
+        std::cerr << "Script not loaded: " << path << "\n";
+        return std::unexpected(ScriptExecutor::SubmitError::SCRIPT_NOT_LOADED);
+    }
+    if (!args.is_array()) {
+        args = json::array({std::move(args)});
+    }
+
+    JobRequest request;
+    request.path = path;
+    request.entry = entry;
+    request.args = std::move(args);
+    auto job = executor_.submit(std::move(request), priority);
+    if (job) {
+        catalogue_.record_run(path);
+    }
+    return job;
+}
+
+// Converts a Lua value into JSON so results outlive the state that produced them
+static json lua_to_json(const sol::object& value, const int depth = 0)
+{
+    if (depth > 16) {
+        return "<max depth>";
+    }
+
+    switch (value.get_type()) {
+    case sol::type::lua_nil:
+    case sol::type::none:
+        return nullptr;
+    case sol::type::boolean:
+        return value.as<bool>();
+    case sol::type::number: {
+        lua_State* L = value.lua_state();
+        const auto pushed = sol::stack::push_pop(value);
+        if (lua_isinteger(L, -1)) {
+            return static_cast<std::int64_t>(lua_tointeger(L, -1));
+        }
+        return lua_tonumber(L, -1);
+    }
+    case sol::type::string:
+        return value.as<std::string>();
+    case sol::type::table: {
+        const sol::table table = value.as<sol::table>();
+        const std::size_t length = table.size();
+        std::size_t entries = 0;
+        for (const auto& entry : table) {
+            (void)entry;
+            ++entries;
+        }
+        json out;
+        // A pure sequence becomes an array; a mixed table becomes an object so its hash keys survive
+        if (length > 0 && entries == length) {
+            out = json::array();
+            for (std::size_t i = 1; i <= length; ++i) {
+                out.push_back(lua_to_json(table[i], depth + 1));
             }
+            return out;
         }
-        Exec_running = false;
-    });
+        out = json::object();
+        for (const auto& [key, entry] : table) {
+            std::string name;
+            if (key.get_type() == sol::type::string) {
+                name = key.as<std::string>();
+            } else {
+                name = lua_to_json(key, depth + 1).dump();
+            }
+            out[name] = lua_to_json(entry, depth + 1);
+        }
+        return out;
+    }
+    default:
+        return "<" + sol::type_name(value.lua_state(), value.get_type()) + ">";
+    }
+}
+
+// batch_loop(entry, records, results, progress, count): calls entry once per record within one protected call.
+// The count comes from the JSON array, since null records leave holes that make the table's length unreliable.
+// No C++ objects are alive here, so an error in a record unwinds straight through it.
+static int batch_loop(lua_State* L)
+{
+    auto* progress = static_cast<std::size_t*>(lua_touserdata(L, 4));
+    const lua_Integer count = lua_tointeger(L, 5);
+    for (lua_Integer i = 1; i <= count; ++i) {
+        *progress = static_cast<std::size_t>(i);
+        lua_pushvalue(L, 1);
+        lua_rawgeti(L, 2, i);
+        lua_call(L, 1, 1);
+        lua_rawseti(L, 3, i);
+    }
+    lua_settop(L, 3);
+    return 1;
+}
+
+// Converts a JSON argument into a Lua value in `lua`; arrays become sequences, objects keyed tables
+static sol::object json_to_lua(sol::state_view lua, const json& value, const int depth = 0)
+{
+    if (depth > 16) {
+        return sol::make_object(lua, sol::lua_nil);
+    }
+
+    switch (value.type()) {
+    case json::value_t::boolean:
+        return sol::make_object(lua, value.get<bool>());
+    case json::value_t::number_integer:
+        return sol::make_object(lua, static_cast<lua_Integer>(value.get<std::int64_t>()));
+    case json::value_t::number_unsigned: {
+        // Above the integer range it becomes a float, as Lua itself reads such a numeral, instead of wrapping negative
+        const auto unsigned_value = value.get<std::uint64_t>();
+        if (unsigned_value > static_cast<std::uint64_t>(std::numeric_limits<lua_Integer>::max())) {
+            return sol::make_object(lua, static_cast<double>(unsigned_value));
+        }
+        return sol::make_object(lua, static_cast<lua_Integer>(unsigned_value));
+    }
+    case json::value_t::number_float:
+        return sol::make_object(lua, value.get<double>());
+    case json::value_t::string:
+        return sol::make_object(lua, value.get_ref<const std::string&>());
+    case json::value_t::array: {
+        sol::table table = lua.create_table(static_cast<int>(value.size()), 0);
+        for (std::size_t i = 0; i < value.size(); ++i) {
+            table[i + 1] = json_to_lua(lua, value[i], depth + 1);
+        }
+        return table;
+    }
+    case json::value_t::object: {
+        sol::table table = lua.create_table(0, static_cast<int>(value.size()));
+        for (const auto& [key, entry] : value.items()) {
+            table[key] = json_to_lua(lua, entry, depth + 1);
+        }
+        return table;
+    }
+    default:
+        return sol::make_object(lua, sol::lua_nil);
+    }
+}
+
+ScriptManager::JobResult ScriptManager::execute_on_pool(const JobRequest& request)
+{
+    JobResult job;
+    const fs::path& path = request.path;
+
+    // First run of a catalogued script: compile before leasing, so no state sits idle behind the parser
+    if (!is_loaded(path) && !compile_on_demand(path).get()) {
+        job.status = JobStatus::FAILED;
+        job.error = "script failed to compile";
+        return job;
+    }
+
+    LuaStatePool::Lease state = pool_.acquire();
+    return execute_on_state(*state, request);
+}
+
+void ScriptManager::execute_on_state(LuaStatePool::PooledState& state, const JobRequest& request, JobResult& job)
+{
+    job.status = JobStatus::UNKNOWN;
+    job.values.clear(); // An array stays an array, with its capacity
+    job.error.clear();
+    job.run_time = {};
+    const fs::path& path = request.path;
+
+    // Safe point: the state is leased and idle, so reloads published since its last run are installed now
+    sync_state(state);
+    const GcPolicy gc_policy = sync_gc_policy(state);
+
+    auto chunk = state.chunks.find(path);
+    if (chunk == state.chunks.end()) {
+        job.status = JobStatus::FAILED;
+        job.error = "script not loaded in pooled state " + std::to_string(state.index);
+        std::cerr << "Script not loaded in pooled state " << state.index << ": " << path << "\n";
+        return;
+    }
+
+    const RunLimits limits = run_limits(path);
+    RunWatchdog::Verdict verdict = RunWatchdog::Verdict::NONE;
+    const auto started = std::chrono::steady_clock::now();
+    {
+        FrameArena::Scope frame(state.frame); // Frame buffers and plugin temporaries die with the run
+        RunWatchdog watchdog(state.lua.lua_state(), limits);
+        std::optional<sol::protected_function_result> result;
+        std::string entry_error;
+        std::size_t batch_record = 0; // Record being processed, names the failing one
+        if (request.entry.empty()) {
+            result.emplace(chunk->second());
+        } else if (auto entry = resolve_entry_point(state, path, request.entry); entry && request.batch) {
+            lua_State* L = state.lua.lua_state();
+            lua_pushcfunction(L, &batch_loop);
+            sol::protected_function loop(L, -1);
+            lua_pop(L, 1);
+            sol::object records = json_to_lua(state.lua, request.args);
+            sol::table results = state.lua.create_table(static_cast<int>(request.args.size()), 0);
+            result.emplace(loop(*entry, records, results, static_cast<void*>(&batch_record),
+                                static_cast<lua_Integer>(request.args.size())));
+        } else if (entry) {
+            // A few arguments (a tick's dt, most call_entry uses) go through a stack array, more through a vector
+            constexpr std::size_t inline_args = 4;
+            std::array<sol::object, inline_args> inline_storage;
+            std::vector<sol::object> heap_storage;
+            std::span<sol::object> args(inline_storage.data(), std::min(request.args.size(), inline_args));
+            if (request.args.size() > inline_args) {
+                heap_storage.resize(request.args.size());
+                args = heap_storage;
+            }
+            for (std::size_t i = 0; i < args.size(); ++i) {
+                args[i] = json_to_lua(state.lua, request.args[i]);
+            }
+            result.emplace((*entry)(sol::as_args(args)));
+        } else {
+            entry_error = std::move(entry.error());
+        }
+        job.run_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+        verdict = watchdog.verdict();
+
+        if (verdict != RunWatchdog::Verdict::NONE) {
+            // Whatever the script's own pcalls saw, the run ended because the watchdog tripped
+            job.status = JobStatus::KILLED;
+            job.error = watchdog.describe();
+            std::cerr << "[ScriptManager] Run of " << path << " " << job.error << "\n";
+        } else if (!result) {
+            std::cerr << "Lua entry point error in " << path << ": " << entry_error << "\n";
+            job.status = JobStatus::FAILED;
+            job.error = entry_error;
+        } else if (!result->valid()) {
+            sol::error err = *result;
+            std::cerr << "Lua script execution error: " << err.what() << "\n";
+            job.status = JobStatus::FAILED;
+            job.error = err.what();
+            if (request.batch) {
+                job.error = "record " + std::to_string(batch_record) + ": " + job.error;
+            }
+        } else if (request.batch) {
+            // One value per record, in order; a record whose call returned nothing yields null
+            job.status = JobStatus::SUCCEEDED;
+            const sol::table results = result->get<sol::table>(0);
+            for (std::size_t i = 1; i <= request.args.size(); ++i) {
+                job.values.push_back(lua_to_json(results.get<sol::object>(i)));
+            }
+        } else {
+            job.status = JobStatus::SUCCEEDED;
+            for (int i = 0; i < result->return_count(); ++i) {
+                job.values.push_back(lua_to_json(result->get<sol::object>(i)));
+            }
+        }
+    }
+
+    // Between runs: bounded collection while the state is still leased but nothing runs on it
+    GcStats gc_stats;
+    {
+        std::lock_guard lock(stats_mutex_);
+        gc_stats = gc_stats_[state.index];
+    }
+    GcController::idle_step(state.lua.lua_state(), gc_policy, gc_stats);
+    {
+        std::lock_guard lock(stats_mutex_);
+        gc_stats_[state.index] = gc_stats;
+        if (verdict == RunWatchdog::Verdict::INSTRUCTION_BUDGET) {
+            kill_stats_[path].budget_kills++;
+        } else if (verdict == RunWatchdog::Verdict::DEADLINE) {
+            kill_stats_[path].deadline_kills++;
+        }
+    }
+}
+
+std::expected<sol::protected_function, std::string> ScriptManager::resolve_entry_point(LuaStatePool::PooledState& state,
+                                                                                     const fs::path& path,
+                                                                                     const std::string& name)
+{
+    const std::uint64_t version = state.chunk_versions[path];
+    LuaStatePool::EntryPoints& entries = state.entry_points[path];
+    if (entries.version != version) {
+        // The top level runs once per chunk version: it defines the entry points, requires modules, builds state
+        entries = {};
+        sol::protected_function_result init = state.chunks.at(path)();
+        if (!init.valid()) {
+            const sol::error err = init;
+            return std::unexpected(std::string("top level failed: ") + err.what());
+        }
+        if (init.return_count() > 0 && init.get_type(0) == sol::type::table) {
+            entries.exports = init.get<sol::table>(0);
+        }
+        entries.version = version;
+    }
+
+    if (auto cached = entries.functions.find(name); cached != entries.functions.end()) {
+        return cached->second;
+    }
+
+    // Returned table first, then the script's globals (its environment falls back to the shared ones)
+    sol::object candidate;
+    if (entries.exports.valid()) {
+        candidate = entries.exports.get<sol::object>(name);
+    }
+    if (!candidate.valid() || candidate.get_type() != sol::type::function) {
+        auto environment = state.environments.find(path);
+        candidate = environment != state.environments.end() ? environment->second.get<sol::object>(name)
+                                                           : state.lua.globals().get<sol::object>(name);
+    }
+    if (candidate.get_type() != sol::type::function) {
+        return std::unexpected("script does not define entry point '" + name + "'");
+    }
+    return entries.functions.emplace(name, candidate.as<sol::protected_function>()).first->second;
+}
+
+void ScriptManager::set_default_run_limits(const RunLimits& limits)
+{
+    std::lock_guard lock(stats_mutex_);
+    default_run_limits_ = limits;
+}
+
+void ScriptManager::set_run_limits(const fs::path& path, std::optional<RunLimits> limits)
+{
+    std::lock_guard lock(stats_mutex_);
+    if (limits) {
+        run_limits_[path] = *limits;
+    } else {
+        run_limits_.erase(path);
+    }
+}
+
+RunLimits ScriptManager::run_limits(const fs::path& path) const
+{
+    std::lock_guard lock(stats_mutex_);
+    auto it = run_limits_.find(path);
+    return it == run_limits_.end() ? default_run_limits_ : it->second;
+}
+
+std::map<fs::path, ScriptManager::KillStats> ScriptManager::script_kill_stats() const
+{
+    std::lock_guard lock(stats_mutex_);
+    return kill_stats_;
+}
+
+void ScriptManager::set_gc_policy(const GcPolicy& policy)
+{
+    std::lock_guard lock(stats_mutex_);
+    gc_policy_ = policy;
+    gc_policy_version_++;
+}
+
+GcPolicy ScriptManager::gc_policy() const
+{
+    std::lock_guard lock(stats_mutex_);
+    return gc_policy_;
+}
+
+std::vector<ScriptManager::StateGcStats> ScriptManager::gc_stats() const
+{
+    std::lock_guard lock(stats_mutex_);
+    std::vector<StateGcStats> out;
+    for (const auto& [index, stats] : gc_stats_) {
+        if (index < pool_.size()) {
+            out.push_back({index, stats});
+        }
+    }
+    return out;
+}
+
+GcPolicy ScriptManager::sync_gc_policy(LuaStatePool::PooledState& state)
+{
+    GcPolicy policy;
+    std::uint64_t version;
+    {
+        std::lock_guard lock(stats_mutex_);
+        policy = gc_policy_;
+        version = gc_policy_version_;
+    }
+    if (state.gc_policy_version != version) {
+        GcController::apply(state.lua.lua_state(), policy);
+        state.gc_policy_version = version;
+    }
+    return policy;
 }
 
 // Saves loaded script paths to disk so they can be restored later
@@ -122,10 +996,20 @@ bool ScriptManager::save_loaded_scripts(const fs::path& json_out_path) const
 {
     nlohmann::json j;
 
-    for (const auto& pair : loaded_scripts_) {
+    for (const auto& pair : registry_.snapshot()->scripts) {
         j["scripts"].push_back(pair.first.string());
     }
 
+    // Catalogued scripts are saved whether or not they were compiled, with run counts for the next prefetch
+    for (const auto& entry : catalogue_.entries()) {
+        if (!is_loaded(entry.path)) {
+            j["scripts"].push_back(entry.path.string());
+        }
+        if (entry.runs > 0) {
+            j["runs"][entry.path.string()] = entry.runs;
+        }
+    }
+
     try {
         std::ofstream o(json_out_path);
         if (!o.is_open()) {
@@ -152,18 +1036,50 @@ bool ScriptManager::restore_scripts_from_json(const fs::path& json_in_path)
         nlohmann::json j;
         i >> j;
 
-        if (j.contains("scripts") && j["scripts"].is_array()) {
+        if (j.contains("scripts") && j["scripts"].is_array() && lazy_loading_) {
+            // Catalogue mode: index only, compile on first run or prefetch
             bool all_successful = true;
+            for (const auto& script_path_str : j["scripts"]) {
+                if (script_path_str.is_string() &&
+                    catalogue_script(script_path_str.get<std::string>()) == SMLoadResult::FILE_LOAD_ERROR) {
+                    all_successful = false;
+                }
+            }
+            if (j.contains("runs") && j["runs"].is_object()) {
+                for (const auto& [script_path, runs] : j["runs"].items()) {
+                    if (runs.is_number_unsigned()) {
+                        catalogue_.set_runs(script_path, runs.get<std::uint64_t>());
+                    }
+                }
+            }
+            std::cout << "[ScriptManager] Catalogued " << catalogue_.size() << " scripts\n";
+            prefetch_scripts(catalogue_.most_run(prefetch_count_));
+            return all_successful;
+        } else if (j.contains("scripts") && j["scripts"].is_array()) {
+            bool all_successful = true;
+            std::vector<fs::path> pending;
             for (const auto& script_path_str : j["scripts"]) {
                 if (script_path_str.is_string()) {
                     fs::path script_path = script_path_str.get<std::string>();
-                    SMLoadResult result = load_script(script_path);
-                    if (result != SMLoadResult::FILE_LOAD_SUCCESS && result != SMLoadResult::FILE_ALREADY_LOADED) {
-                        std::cerr << "Failed to load script from JSON: " << script_path << "\n";
-                        all_successful = false;
+                    if (!is_loaded(script_path)) {
+                        pending.push_back(std::move(script_path));
                     }
                 }
             }
+
+            // Parse everything in parallel in scratch states, then publish the bytecode as one snapshot
+            std::vector<std::pair<fs::path, ScriptRegistry::Entry>> entries;
+            for (auto& [script_path, chunk] : compile_service_.compile_all(pending)) {
+                if (!chunk) {
+                    std::cerr << "Lua load error in " << script_path << ": " << chunk.error() << "\n";
+                    std::cerr << "Failed to load script from JSON: " << script_path << "\n";
+                    all_successful = false;
+                    continue;
+                }
+                entries.emplace_back(script_path, make_entry(script_path, *chunk));
+                watcher_.watch(script_path);
+            }
+            publish_chunks(std::move(entries));
             return all_successful;
         } else {
             std::cerr << "JSON file does not contain a 'scripts' array: " << json_in_path << "\n";
@@ -175,48 +1091,40 @@ bool ScriptManager::restore_scripts_from_json(const fs::path& json_in_path)
     }
 }
 
-// Updates watched files and reloads any that have changed
-void ScriptManager::start_watcher_thread()
+// Watches every loaded script and reloads the ones whose content changed
+void ScriptManager::start_watcher_thread(const std::chrono::milliseconds debounce)
 {
-    std::cout << "Watcher Thread Started\n";
-    std::thread([this]()
-    {
-        while (!HotReload_StopRequested)
-        {
-            std::vector<fs::path> changed_scripts;
-
-            // First pass: check which files changed
-            for (const auto& [path, time] : file_watch_times_)
-            {
-                try {
-                    auto current_time = std::filesystem::last_write_time(path);
-                    if (time != current_time)
-                    {
-                        changed_scripts.push_back(path);
-                    }
-                } catch (const std::exception& e) {
-                    std::cerr << "Error checking file time for " << path << ": " << e.what() << "\n";
-                }
-            }
+    watcher_debounce_ = debounce;
+    for (const auto& [path, entry] : registry_.snapshot()->scripts) {
+        watcher_.watch(path);
+    }
 
-            // Second pass: reload changed files and update watch times
-            for (const auto& path : changed_scripts)
-            {
-                std::cout << "Script at " << path << " has been modified. Reloading...\n";
-                if (reload_script(path))
-                {
-                    file_watch_times_[path] = std::filesystem::last_write_time(path);
-                }
+    // Runs on the watcher thread; compiling happens on the compile service, live states are never touched here
+    watcher_.start([this](const std::vector<FileWatcher::Change>& changes) {
+        std::vector<fs::path> modules;
+        for (const auto& change : changes) {
+            std::cout << "Script at " << change.path << " has been modified. Reloading...\n";
+            fs::path file = ModuleGraph::normalise(change.path);
+            if (module_graph_.is_module(file)) {
+                modules.push_back(std::move(file));
             }
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(750));
         }
+        if (!modules.empty()) {
+            invalidate_modules(modules);
+        }
+        reload_scripts(changes);
+    }, debounce);
+    std::cout << "Watcher Thread Started\n";
+}
 
-        std::cout << "Watcher Thread Stopped\n";
-    }).detach();
+void ScriptManager::stop_watcher_thread() { watcher_.stop(); }
+
+ScriptManager::HotReloadStats ScriptManager::hot_reload_stats() const
+{
+    std::lock_guard lock(stats_mutex_);
+    return reload_stats_;
 }
 
-void ScriptManager::stop_watcher_thread(){ HotReload_StopRequested = true; }
 
 // Access to the Lua state for advanced usage if needed
 const sol::state& ScriptManager::lua_state()
@@ -233,29 +1141,157 @@ const sol::state& ScriptManager::lua_state()
 
 // Internal helper to reload a single script
 bool ScriptManager::reload_script(const fs::path& path) {
-    if (!loaded_scripts_.contains(path)) {
-        return false;  // Can't reload something that's not loaded
+    return reload_scripts({{path, FileWatcher::Clock::now()}}) == 1;
+}
+
+// Compiles changed scripts in parallel off-thread, then publishes the ones whose content hash changed
+std::size_t ScriptManager::reload_scripts(const std::vector<FileWatcher::Change>& changes) {
+    std::vector<fs::path> loaded;
+    std::unordered_map<fs::path, FileWatcher::Clock::time_point> first_seen;
+    for (const auto& change : changes) {
+        if (is_loaded(change.path)) {
+            loaded.push_back(change.path);  // Can't reload something that's not loaded
+            first_seen.emplace(change.path, change.first_seen);
+        }
     }
 
-    try {
-        sol::load_result script = lua_.load_file(path.string());
+    std::vector<std::pair<fs::path, ScriptRegistry::Entry>> entries;
+    std::uint64_t failures = 0;
+    std::uint64_t unchanged = 0;
+    const ScriptRegistry::SnapshotPtr current = registry_.snapshot();
+    for (auto& [path, chunk] : compile_service_.compile_all(loaded)) {
+        if (!chunk) {
+            std::cout << "Script reload error at " << path << ": " << chunk.error() << "\n";
+            failures++;
+            continue;
+        }
 
-        if (!script.valid()) {
-            const sol::error err = script;
-            std::cout << "Script reload error at " << path << ": " << err.what();
-            return false;
+        // Touched or re-saved without edits: keep the installed chunk so no state reloads it
+        auto installed = current->scripts.find(path);
+        if (installed != current->scripts.end() && installed->second.source_hash == chunk->source_hash) {
+            unchanged++;
+            continue;
         }
+        entries.emplace_back(path, make_entry(path, *chunk));
+    }
 
+    // Nothing live is touched here: pooled states install the new chunks when next leased,
+    // and runs already in flight finish on the snapshot they started with
+    std::vector<fs::path> published;
+    for (const auto& [path, entry] : entries) {
+        published.push_back(path);
+    }
+    publish_chunks(std::move(entries));
+    const auto now = FileWatcher::Clock::now();
 
-        loaded_scripts_[path] = std::move(script);
+    std::lock_guard lock(stats_mutex_);
+    reload_stats_.failures += failures;
+    reload_stats_.unchanged_skipped += unchanged;
+    for (const auto& path : published) {
+        const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - first_seen[path]);
+        reload_stats_.reloads++;
+        reload_stats_.last_latency = latency;
+        reload_stats_.max_latency = std::max(reload_stats_.max_latency, latency);
+        reload_stats_.total_latency += latency;
+        std::cout << "Reloaded " << path << " in " << latency.count() << "us\n";
+    }
+    return published.size();
+}
 
-        // file_watch_times_.erase(path);
-        // file_watch_times_.emplace(path, std::filesystem::last_write_time(path)); causes segfault.
+// Registry key holding the module graph epoch a state last applied
+static constexpr const char* module_epoch_key = "mapper.module_epoch";
 
-        return true;
+void ScriptManager::install_module_tracking(sol::state& lua)
+{
+    lua_State* L = lua.lua_state();
+    lua_pushinteger(L, static_cast<lua_Integer>(module_graph_.epoch()));
+    lua_setfield(L, LUA_REGISTRYINDEX, module_epoch_key);
 
-    } catch (const std::exception& e) {
-        std::cerr << "Lua load exception in " << path << ": " << e.what() << "\n";
-        return false;
+    // Upvalues: this manager, the original require
+    lua_pushlightuserdata(L, this);
+    lua_getglobal(L, "require");
+    lua_pushcclosure(L, &ScriptManager::tracked_require, 2);
+    lua_setglobal(L, "require");
+}
+
+int ScriptManager::tracked_require(lua_State* L)
+{
+    auto* self = static_cast<ScriptManager*>(lua_touserdata(L, lua_upvalueindex(1)));
+    luaL_checkstring(L, 1);
+    self->apply_module_invalidations(L);
+
+    // No C++ objects are alive across this call, a Lua error unwinds straight through it
+    lua_settop(L, 1);
+    lua_pushvalue(L, lua_upvalueindex(2));
+    lua_pushvalue(L, 1);
+    lua_call(L, 1, 2);
+
+    self->record_require(L);
+    return 2;
+}
+
+// Stack: name, module, loader data (the file path the first time a Lua module is loaded)
+void ScriptManager::record_require(lua_State* L)
+{
+    const std::string name = lua_tostring(L, 1);
+    fs::path file;
+    if (lua_type(L, -1) == LUA_TSTRING) {
+        file = ModuleGraph::normalise(lua_tostring(L, -1));
+    } else if (auto known = module_graph_.file_for(name)) {
+        file = *known;
+    } else {
+        return; // Preloaded, or loaded before tracking was installed
+    }
+
+    // The caller's chunk name is "@<file>" for scripts and file-searched modules alike
+    fs::path requirer;
+    lua_Debug ar;
+    if (lua_getstack(L, 1, &ar) && lua_getinfo(L, "S", &ar) && ar.source && ar.source[0] == '@') {
+        requirer = ModuleGraph::normalise(ar.source + 1);
+    }
+
+    if (module_graph_.record(requirer, name, file)) {
+        watcher_.watch(file);
+    }
+}
+
+void ScriptManager::apply_module_invalidations(lua_State* L)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, module_epoch_key);
+    const auto synced = static_cast<std::uint64_t>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+
+    const std::uint64_t epoch = module_graph_.epoch();
+    if (synced == epoch) {
+        return;
     }
-}
\ No newline at end of file
+
+    // Dropping the cached value is enough, the next require of each name loads the file again
+    lua_getfield(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+    for (const std::string& name : module_graph_.invalidated_since(synced)) {
+        lua_pushnil(L);
+        lua_setfield(L, -2, name.c_str());
+    }
+    lua_pop(L, 1);
+
+    lua_pushinteger(L, static_cast<lua_Integer>(epoch));
+    lua_setfield(L, LUA_REGISTRYINDEX, module_epoch_key);
+}
+
+std::size_t ScriptManager::invalidate_modules(const std::vector<fs::path>& module_files)
+{
+    const std::vector<std::string> names = module_graph_.invalidate(module_files);
+    if (names.empty()) {
+        return 0;
+    }
+
+    std::cout << "[ScriptManager] Invalidated modules:";
+    for (const std::string& name : names) {
+        std::cout << " " << name;
+    }
+    std::cout << "\n";
+
+    std::lock_guard lock(stats_mutex_);
+    reload_stats_.modules_invalidated += names.size();
+    return names.size();
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/ScriptRegistry.cpp
+#include "Scripting/ScriptRegistry.h"
+
+std::uint64_t ScriptRegistry::publish(const std::filesystem::path& path, Entry entry)
+{
+    return update([&](Snapshot& next, const std::uint64_t generation) {
+        entry.version = generation;
+        next.scripts[path] = std::move(entry);
+    });
+}
+
+std::uint64_t ScriptRegistry::update(const Edit& edit)
+{
+    std::lock_guard lock(writer_mutex_);
+    auto next = std::make_shared<Snapshot>(*current_.load(std::memory_order_acquire));
+    next->generation++;
+    edit(*next, next->generation);
+    const std::uint64_t generation = next->generation;
+
+    // Readers holding the old snapshot keep it alive until they are done with it
+    current_.store(std::move(next), std::memory_order_release);
+    generation_.store(generation, std::memory_order_release);
+    return generation;
+}
+
+bool ScriptRegistry::erase(const std::filesystem::path& path)
+{
+    std::lock_guard lock(writer_mutex_);
+    SnapshotPtr current = current_.load(std::memory_order_acquire);
+    if (!current->scripts.contains(path)) {
+        return false;
+    }
+    auto next = std::make_shared<Snapshot>(*current);
+    next->scripts.erase(path);
+    const std::uint64_t generation = ++next->generation;
+    current_.store(std::move(next), std::memory_order_release);
+    generation_.store(generation, std::memory_order_release);
+    return true;
+}
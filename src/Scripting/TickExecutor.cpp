@@ -0,0 +1,296 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/TickExecutor.cpp
+#include "Scripting/TickExecutor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+// Within this of the next release the thread sleeps in clock_nanosleep for precision. Further out it waits on
+// wake_cv_, so add(), remove(), post() and stop() reach it at once; none of them waits longer than this.
+static constexpr auto precise_sleep = std::chrono::milliseconds(2);
+
+void TickExecutor::start(const StateHook& warm, RunFn run, const bool size_class_allocator, const int realtime_priority)
+{
+    if (running_) {
+        return;
+    }
+
+    auto state = LuaStatePool::make_state(size_class_allocator);
+    if (warm) {
+        warm(*state);
+    }
+    {
+        std::lock_guard lock(mutex_);
+        state_ = std::move(state);
+        run_ = std::move(run);
+    }
+
+    stop_requested_ = false;
+    running_ = true;
+    thread_ = std::thread([this] { run_loop(); });
+
+#ifdef __linux__
+    if (realtime_priority > 0) {
+        sched_param param{};
+        param.sched_priority = realtime_priority;
+        if (const int err = pthread_setschedparam(thread_.native_handle(), SCHED_FIFO, &param); err != 0) {
+            std::cerr << "[TickExecutor] SCHED_FIFO " << realtime_priority << " unavailable (" << std::strerror(err)
+                      << "), running at normal priority\n";
+        }
+    }
+#else
+    (void)realtime_priority;
+#endif
+    std::cout << "[TickExecutor] Started\n";
+}
+
+void TickExecutor::stop()
+{
+    if (!running_) {
+        return;
+    }
+    {
+        // Under the mutex so the flag cannot land between run_loop's predicate check and its wait
+        std::lock_guard lock(mutex_);
+        stop_requested_ = true;
+    }
+    wake_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    {
+        std::lock_guard lock(mutex_);
+        ticks_.clear();
+        pending_updates_.clear();
+        state_.reset();
+    }
+    running_ = false;
+    std::cout << "[TickExecutor] Stopped\n";
+}
+
+std::expected<TickExecutor::TickId, std::string> TickExecutor::add(const std::filesystem::path& path,
+                                                                    const std::chrono::microseconds period,
+                                                                    const std::string& entry)
+{
+    if (!running_) {
+        return std::unexpected("tick executor is not running");
+    }
+    if (period <= std::chrono::microseconds::zero()) {
+        return std::unexpected("tick period must be positive");
+    }
+
+    TickId id;
+    {
+        std::lock_guard lock(mutex_);
+        id = next_id_++;
+        Tick tick;
+        tick.info.id = id;
+        tick.info.path = path;
+        tick.info.entry = entry;
+        tick.info.period = period;
+        tick.request = std::make_shared<ScriptExecutor::JobRequest>();
+        tick.request->path = path;
+        tick.request->entry = entry;
+        if (!entry.empty()) {
+            tick.request->args.push_back(0.0);
+        }
+        tick.next_release = Clock::now() + period;
+        tick.last_start = tick.next_release - period;
+        ticks_.emplace(id, std::move(tick));
+        ++schedule_version_;
+    }
+    wake_cv_.notify_all();
+    return id;
+}
+
+bool TickExecutor::remove(const TickId id)
+{
+    {
+        std::lock_guard lock(mutex_);
+        if (ticks_.erase(id) == 0) {
+            return false;
+        }
+        ++schedule_version_;
+    }
+    wake_cv_.notify_all();
+    return true;
+}
+
+void TickExecutor::post(StateHook update)
+{
+    {
+        // Checked under the mutex: once stop() has set the flag, an update would land after the final clear and
+        // never be applied or released
+        std::lock_guard lock(mutex_);
+        if (!running_ || stop_requested_) {
+            return;
+        }
+        pending_updates_.push_back(std::move(update));
+    }
+    wake_cv_.notify_all();
+}
+
+std::vector<TickExecutor::TickInfo> TickExecutor::ticks() const
+{
+    std::lock_guard lock(mutex_);
+    std::vector<TickInfo> out;
+    out.reserve(ticks_.size());
+    for (const auto& [id, tick] : ticks_) {
+        out.push_back(tick.info);
+    }
+    return out;
+}
+
+void TickExecutor::apply_pending()
+{
+    std::vector<StateHook> updates;
+    {
+        std::lock_guard lock(mutex_);
+        updates.swap(pending_updates_);
+    }
+    for (const StateHook& update : updates) {
+        try {
+            update(*state_);
+        } catch (const std::exception& e) {
+            std::cerr << "[TickExecutor] Exception applying update: " << e.what() << "\n";
+        }
+    }
+}
+
+void TickExecutor::sleep_until(const Clock::time_point until)
+{
+#ifdef __linux__
+    const auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(until.time_since_epoch());
+    timespec wake{};
+    wake.tv_sec = static_cast<time_t>(since_epoch.count() / 1'000'000'000);
+    wake.tv_nsec = static_cast<long>(since_epoch.count() % 1'000'000'000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) == EINTR) {
+    }
+#else
+    std::this_thread::sleep_until(until);
+#endif
+}
+
+void TickExecutor::run_loop()
+{
+    ScriptExecutor::JobResult result; // Reused by every tick
+    while (!stop_requested_) {
+        apply_pending();
+
+        // Earliest deadline among released ticks; with none released, the next release to sleep until
+        TickId due = 0;
+        Clock::time_point release{};
+        Clock::time_point next_release = Clock::time_point::max();
+        {
+            std::unique_lock lock(mutex_);
+            if (!pending_updates_.empty()) {
+                continue; // Posted since apply_pending, applied before anything runs
+            }
+
+            const auto now = Clock::now();
+            Clock::time_point earliest_deadline = Clock::time_point::max();
+            for (const auto& [id, tick] : ticks_) {
+                if (tick.next_release > now) {
+                    next_release = std::min(next_release, tick.next_release);
+                    continue;
+                }
+                const auto deadline = tick.next_release + tick.info.period;
+                if (deadline < earliest_deadline) {
+                    earliest_deadline = deadline;
+                    due = id;
+                    release = tick.next_release;
+                }
+            }
+
+            // Nothing due soon: wait, in the same critical section as the scan, for the schedule to change, an
+            // update, stop(), or the point where the precise sleep takes over
+            if (due == 0 && (next_release == Clock::time_point::max() || next_release - now > precise_sleep)) {
+                const std::uint64_t seen = schedule_version_;
+                const auto woken = [this, seen] {
+                    return stop_requested_ || !pending_updates_.empty() || schedule_version_ != seen;
+                };
+                if (next_release == Clock::time_point::max()) {
+                    wake_cv_.wait(lock, woken);
+                } else {
+                    wake_cv_.wait_until(lock, next_release - precise_sleep, woken);
+                }
+                continue;
+            }
+        }
+
+        if (due == 0) {
+            sleep_until(next_release);
+            continue;
+        }
+
+        std::shared_ptr<ScriptExecutor::JobRequest> request;
+        const auto started = Clock::now();
+        {
+            std::lock_guard lock(mutex_);
+            auto it = ticks_.find(due);
+            if (it == ticks_.end()) {
+                continue; // Removed since it was picked
+            }
+            request = it->second.request;
+            if (!request->entry.empty()) {
+                // Overwrites a number in place, the array is not reallocated
+                request->args[0] = std::chrono::duration<double>(started - it->second.last_start).count();
+            }
+            it->second.last_start = started;
+        }
+
+        try {
+            run_(*state_, *request, result);
+        } catch (const std::exception& e) {
+            result.status = ScriptExecutor::JobStatus::FAILED;
+            result.error = e.what();
+        }
+        const auto finished = Clock::now();
+
+        std::lock_guard lock(mutex_);
+        auto it = ticks_.find(due);
+        if (it == ticks_.end()) {
+            continue;
+        }
+        Tick& tick = it->second;
+        TickStats& stats = tick.info.stats;
+        const auto period = tick.info.period;
+        const auto jitter = std::chrono::duration_cast<std::chrono::microseconds>(started - release);
+        const auto run_time = std::chrono::duration_cast<std::chrono::microseconds>(finished - started);
+
+        stats.runs++;
+        if (result.status != ScriptExecutor::JobStatus::SUCCEEDED) {
+            stats.failures++;
+        }
+        if (run_time > period) {
+            stats.overruns++;
+        }
+        if (finished > release + period) {
+            stats.deadline_misses++;
+        }
+        stats.last_jitter = jitter;
+        stats.max_jitter = std::max(stats.max_jitter, jitter);
+        stats.total_jitter += jitter;
+        stats.last_run_time = run_time;
+        stats.max_run_time = std::max(stats.max_run_time, run_time);
+        stats.total_run_time += run_time;
+
+        // Next release keeps the original phase; releases that already passed whole are skipped
+        tick.next_release = release + period;
+        if (tick.next_release + period <= finished) {
+            const auto behind = (finished - tick.next_release) / period;
+            stats.skipped += static_cast<std::uint64_t>(behind);
+            tick.next_release += behind * period;
+        }
+    }
+}
@@ -0,0 +1,422 @@
+// Copyright (c) 2025 Lachlan McKenna - MapperEngine
+// All rights reserved. No part of this code may be used, copied, or distributed without permission.
+// /src/Scripting/ZygoteSupervisor.cpp
+#include "Scripting/ZygoteSupervisor.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <string>
+
+#include "Scripting/ScriptManager.h"
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+// Frames are a native-endian 32-bit length followed by the payload; both ends are the same binary
+static bool write_all(const int fd, const char* data, std::size_t size)
+{
+    while (size > 0) {
+        // send() rather than write(), a worker that died must not raise SIGPIPE in the supervisor
+        const ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+static bool read_all(const int fd, char* data, std::size_t size)
+{
+    while (size > 0) {
+        const ssize_t got = read(fd, data, size);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        data += got;
+        size -= static_cast<std::size_t>(got);
+    }
+    return true;
+}
+
+static bool write_frame(const int fd, const std::string& payload)
+{
+    const auto length = static_cast<std::uint32_t>(payload.size());
+    return write_all(fd, reinterpret_cast<const char*>(&length), sizeof(length)) &&
+           write_all(fd, payload.data(), payload.size());
+}
+
+static std::optional<std::string> read_frame(const int fd)
+{
+    std::uint32_t length = 0;
+    if (!read_all(fd, reinterpret_cast<char*>(&length), sizeof(length))) {
+        return std::nullopt;
+    }
+    std::string payload(length, '\0');
+    if (!read_all(fd, payload.data(), length)) {
+        return std::nullopt;
+    }
+    return payload;
+}
+
+// Passes `fd` (or nothing when negative) and the worker pid from the zygote to the supervisor
+static bool send_worker(const int socket, const int fd, int pid)
+{
+    iovec iov{&pid, sizeof(pid)};
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    if (fd >= 0) {
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+    }
+    return sendmsg(socket, &message, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(pid));
+}
+
+static bool receive_worker(const int socket, int& fd, int& pid)
+{
+    iovec iov{&pid, sizeof(pid)};
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    fd = -1;
+    if (recvmsg(socket, &message, MSG_CMSG_CLOEXEC) != static_cast<ssize_t>(sizeof(pid))) {
+        return false;
+    }
+    if (cmsghdr* header = CMSG_FIRSTHDR(&message); header && header->cmsg_type == SCM_RIGHTS) {
+        std::memcpy(&fd, CMSG_DATA(header), sizeof(int));
+    }
+    return fd >= 0;
+}
+#endif
+
+static json request_to_json(const ScriptExecutor::JobRequest& request)
+{
+    return {{"path", request.path.string()}, {"entry", request.entry}, {"args", request.args}, {"batch", request.batch}};
+}
+
+static ScriptExecutor::JobResult failed_result(std::string error)
+{
+    ScriptExecutor::JobResult result;
+    result.status = ScriptExecutor::JobStatus::FAILED;
+    result.error = std::move(error);
+    return result;
+}
+
+bool ZygoteSupervisor::start(const std::size_t worker_count)
+{
+#ifndef _WIN32
+    if (running_) {
+        return true;
+    }
+
+    int control[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, control) != 0) {
+        std::cerr << "[ZygoteSupervisor] socketpair failed: " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    // Nothing may be mid-way through a lock when the zygote is cloned from this process
+    scripts_.prepare_fork();
+    std::cout.flush();
+    std::cerr.flush();
+    const pid_t pid = fork();
+    if (pid == 0) {
+        close(control[0]);
+        zygote_main(scripts_, control[1]);
+    }
+    scripts_.resume_after_fork();
+    close(control[1]);
+    if (pid < 0) {
+        std::cerr << "[ZygoteSupervisor] fork failed: " << std::strerror(errno) << "\n";
+        close(control[0]);
+        return false;
+    }
+    zygote_pid_ = pid;
+    control_fd_ = control[0];
+
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = false;
+    }
+    for (std::size_t i = 0; i < worker_count; ++i) {
+        auto worker = std::make_unique<Worker>();
+        if (!spawn_worker(*worker)) {
+            break;
+        }
+        workers_.push_back(std::move(worker));
+    }
+    for (const auto& worker : workers_) {
+        worker->dispatcher = std::thread([this, &worker = *worker] { dispatch_loop(worker); });
+    }
+    {
+        std::lock_guard lock(mutex_);
+        stats_.workers = workers_.size();
+    }
+    running_ = true;
+    std::cout << "[ZygoteSupervisor] Zygote " << zygote_pid_ << ", workers: " << workers_.size() << "\n";
+    if (workers_.empty()) {
+        stop();
+        return false;
+    }
+    return true;
+#else
+    (void)worker_count;
+    std::cerr << "[ZygoteSupervisor] Zygote mode needs fork(), not available on this platform\n";
+    return false;
+#endif
+}
+
+void ZygoteSupervisor::stop()
+{
+#ifndef _WIN32
+    if (!running_) {
+        return;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    for (const auto& worker : workers_) {
+        if (worker->dispatcher.joinable()) {
+            worker->dispatcher.join();
+        }
+        // EOF on the job socket is the worker's signal to exit
+        if (worker->fd >= 0) {
+            close(worker->fd);
+        }
+    }
+    workers_.clear();
+
+    std::deque<PendingJob> abandoned;
+    {
+        std::lock_guard lock(mutex_);
+        abandoned.swap(queue_);
+        stats_.failures += abandoned.size();
+        stats_.workers = 0;
+    }
+    for (PendingJob& job : abandoned) {
+        job.promise.set_value(failed_result("zygote supervisor stopped"));
+    }
+
+    close(control_fd_);
+    control_fd_ = -1;
+    waitpid(zygote_pid_, nullptr, 0);
+    zygote_pid_ = -1;
+    running_ = false;
+    std::cout << "[ZygoteSupervisor] Stopped\n";
+#endif
+}
+
+std::future<ZygoteSupervisor::JobResult> ZygoteSupervisor::submit(JobRequest request)
+{
+    PendingJob job{std::move(request), {}};
+    std::future<JobResult> result = job.promise.get_future();
+    {
+        std::lock_guard lock(mutex_);
+        if (running_ && !stopping_ && stats_.workers > 0) {
+            queue_.push_back(std::move(job));
+            work_cv_.notify_one();
+            return result;
+        }
+    }
+    job.promise.set_value(failed_result("zygote supervisor not running"));
+    return result;
+}
+
+ZygoteSupervisor::Stats ZygoteSupervisor::stats() const
+{
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+bool ZygoteSupervisor::spawn_worker(Worker& worker)
+{
+#ifndef _WIN32
+    std::lock_guard lock(control_mutex_);
+    int fd = -1;
+    int pid = -1;
+    if (!write_frame(control_fd_, "spawn") || !receive_worker(control_fd_, fd, pid)) {
+        std::cerr << "[ZygoteSupervisor] Zygote could not start a worker\n";
+        return false;
+    }
+    worker.fd = fd;
+    worker.pid = pid;
+    return true;
+#else
+    (void)worker;
+    return false;
+#endif
+}
+
+void ZygoteSupervisor::dispatch_loop(Worker& worker)
+{
+#ifndef _WIN32
+    while (true) {
+        PendingJob job;
+        {
+            std::unique_lock lock(mutex_);
+            work_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_) {
+                return; // Queued jobs are failed by stop()
+            }
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        std::optional<std::string> reply;
+        if (write_frame(worker.fd, request_to_json(job.request).dump(-1, ' ', false, json::error_handler_t::replace))) {
+            reply = read_frame(worker.fd);
+        }
+
+        JobResult result;
+        if (reply) {
+            try {
+                const json parsed = json::parse(*reply);
+                result.status = static_cast<ScriptExecutor::JobStatus>(parsed.at("status").get<int>());
+                result.values = parsed.at("values");
+                result.error = parsed.at("error").get<std::string>();
+                result.run_time = std::chrono::microseconds(parsed.at("run_time_us").get<std::int64_t>());
+            } catch (const std::exception& e) {
+                result = failed_result(std::string("malformed worker reply: ") + e.what());
+            }
+        } else {
+            result = failed_result("worker " + std::to_string(worker.pid) + " exited");
+        }
+        {
+            std::lock_guard lock(mutex_);
+            ++stats_.jobs;
+            if (result.status != ScriptExecutor::JobStatus::SUCCEEDED) {
+                ++stats_.failures;
+            }
+        }
+        job.promise.set_value(std::move(result));
+
+        if (!reply) {
+            // The zygote reaps its children, replacing the worker is all that is left to do
+            std::cerr << "[ZygoteSupervisor] Worker " << worker.pid << " lost, respawning\n";
+            close(worker.fd);
+            worker.fd = -1;
+            const bool respawned = spawn_worker(worker);
+            std::deque<PendingJob> stranded;
+            {
+                std::lock_guard lock(mutex_);
+                if (respawned) {
+                    ++stats_.respawns;
+                    continue;
+                }
+                // Without any worker left nothing would ever take the queued jobs
+                if (--stats_.workers == 0) {
+                    stranded.swap(queue_);
+                    stats_.failures += stranded.size();
+                }
+            }
+            for (PendingJob& stranded_job : stranded) {
+                stranded_job.promise.set_value(failed_result("no zygote workers left"));
+            }
+            return;
+        }
+    }
+#else
+    (void)worker;
+#endif
+}
+
+void ZygoteSupervisor::zygote_main(ScriptManager& scripts, const int control_fd)
+{
+#ifndef _WIN32
+    // Single-threaded from here on: fork freely, let the kernel reap the workers
+    std::signal(SIGCHLD, SIG_IGN);
+    while (read_frame(control_fd)) {
+        int job[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, job) != 0) {
+            send_worker(control_fd, -1, -1);
+            continue;
+        }
+        std::cout.flush();
+        const pid_t pid = fork();
+        if (pid == 0) {
+            close(control_fd);
+            close(job[0]);
+            worker_main(scripts, job[1]);
+        }
+        close(job[1]);
+        send_worker(control_fd, pid < 0 ? -1 : job[0], pid);
+        close(job[0]);
+    }
+#else
+    (void)scripts;
+    (void)control_fd;
+#endif
+    // No destructors: they belong to the process this was forked from
+    std::cout.flush();
+    std::_Exit(0);
+}
+
+void ZygoteSupervisor::worker_main(ScriptManager& scripts, const int job_fd)
+{
+#ifndef _WIN32
+    std::signal(SIGCHLD, SIG_DFL);
+    scripts.resume_after_fork(ScriptManager::ForkSide::CHILD);
+
+    while (auto frame = read_frame(job_fd)) {
+        JobResult result;
+        try {
+            const json parsed = json::parse(*frame);
+            const std::filesystem::path path = parsed.at("path").get<std::string>();
+            const std::string entry = parsed.at("entry").get<std::string>();
+            json args = parsed.at("args");
+
+            auto id = entry.empty()              ? scripts.run_script(path)
+                      : parsed.at("batch").get<bool>() ? scripts.call_entry_batch(path, entry, std::move(args))
+                                                       : scripts.call_entry(path, entry, std::move(args));
+            result = id ? scripts.wait_for_job(*id)
+                        : failed_result("rejected: " + std::string(ScriptExecutor::to_string(id.error())));
+        } catch (const std::exception& e) {
+            result = failed_result(std::string("malformed job: ") + e.what());
+        }
+
+        const json reply = {{"status", static_cast<int>(result.status)},
+                            {"values", result.values},
+                            {"error", result.error},
+                            {"run_time_us", result.run_time.count()}};
+        if (!write_frame(job_fd, reply.dump(-1, ' ', false, json::error_handler_t::replace))) {
+            break;
+        }
+    }
+#else
+    (void)scripts;
+    (void)job_fd;
+#endif
+    // The supervisor closed the socket; leave without tearing down a copy of its engine
+    std::cout.flush();
+    std::_Exit(0);
+}
@@ -30,7 +30,9 @@
         std::cin >> input;
         if (input == "1")
         {
-            ScriptMgr.run_script(testScriptPath);
+            if (auto job = ScriptMgr.run_script(testScriptPath); !job) {
+                std::cerr << "Run rejected: " << ScriptExecutor::to_string(job.error()) << "\n";
+            }
         }
     }
 
@@ -3,9 +3,20 @@
 // /src/plugins/pluginLoader.h
 
 #include "plugins/PluginManager.h"
+#include <atomic>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "nlohmann/json.hpp"
 
@@ -26,12 +37,32 @@ const std::string libName =
 
 
 bool PluginManager::loadPluginMetadata(const fs::path& pluginDir) const
+{
+    std::optional<plugin> parsed = parsePluginMetadata(pluginDir);
+    if (!parsed) {
+        return false;
+    }
+    if (CheckIfPluginExists(parsed->name)) {
+        std::cout << "Plugin named \"" << parsed->name << "\" already exists, discarding...\n";
+        return false;
+    }
+    registerPlugin(std::move(*parsed));
+    return true;
+}
+
+void PluginManager::registerPlugin(plugin&& newPlugin) const
+{
+    pluginIndex->emplace(newPlugin.name, loadedPlugins->size());
+    loadedPlugins->push_back(std::move(newPlugin));
+}
+
+std::optional<PluginManager::plugin> PluginManager::parsePluginMetadata(const fs::path& pluginDir)
 {
 
     // Basic sanity checks
     if (!fs::exists(pluginDir) || !fs::is_directory(pluginDir)) {
         std::cerr << "Plugin directory does not exist or is not a directory: " << pluginDir << '\n';
-        return false;
+        return std::nullopt;
     }
 
     // Determine the library filename based on platform
@@ -50,7 +81,7 @@ bool PluginManager::loadPluginMetadata(const fs::path& pluginDir) const
     // Check library file exists before trying to load
     if (!fs::exists(libPath)) {
         std::cerr << "Plugin library not found: " << libPath << '\n';
-        return false;
+        return std::nullopt;
     }
 
     // Check Lua script file existence (warn only, optional)
@@ -93,47 +124,462 @@ bool PluginManager::loadPluginMetadata(const fs::path& pluginDir) const
             newPlugin.version = metadata.value("version", "0.0.0");
             newPlugin.description = metadata.value("description", "N/A");
             newPlugin.dependencies = metadata.value("dependencies", json::array());
-
-            if (CheckIfPluginExists(newPlugin.name)) {
-                std::cout << "Plugin named \"" << newPlugin.name << "\" already exists, discarding...\n";
-                return false;
-            }
         }
     }
-    // Construct plugin with folder path (other paths will be set below)
+    return newPlugin;
+}
 
-    loadedPlugins->push_back(std::move(newPlugin));
-    return true;
+
+// A copy of `lib_path` under the temp directory, unique to this process and build, for dlopen to map.
+// The linker can then rewrite lib_path in place without corrupting the image in use, and the loader
+// sees a new file each time instead of handing back the build it already has open.
+static fs::path shadowCopy(const fs::path& lib_path, const std::uint64_t generation)
+{
+#ifdef _WIN32
+    const auto pid = _getpid();
+#else
+    const auto pid = getpid();
+#endif
+    const fs::path dir = fs::temp_directory_path() / "mapper-plugins" / std::to_string(pid);
+    fs::create_directories(dir);
+    const fs::path copy = dir / (lib_path.parent_path().filename().string() + "-" + std::to_string(generation) +
+                                 lib_path.extension().string());
+    fs::copy_file(lib_path, copy, fs::copy_options::overwrite_existing);
+    return copy;
 }
 
+std::shared_ptr<dynalo::library> PluginManager::acquireLibrary(const fs::path& lib_path)
+{
+    struct Entry {
+        std::mutex mutex;
+        std::shared_ptr<dynalo::library> library;
+        fs::file_time_type write_time{}; // Of lib_path when `library` was copied from it
+        std::uintmax_t size = 0;
+        std::vector<std::shared_ptr<dynalo::library>> retired; // Earlier builds, never closed
+    };
+    static std::mutex mutex;
+    static std::unordered_map<fs::path, std::shared_ptr<Entry>> libraries;
+    static std::atomic<std::uint64_t> generations = 0;
+
+    std::error_code ec;
+    const fs::path canonical = fs::weakly_canonical(lib_path, ec);
+    const fs::path& key = ec ? lib_path : canonical;
+
+    // The map lock only covers the lookup, loaders opening different libraries do not wait on each other
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard lock(mutex);
+        auto& slot = libraries[key];
+        if (!slot) {
+            slot = std::make_shared<Entry>();
+        }
+        entry = slot;
+    }
+    std::lock_guard lock(entry->mutex);
+    const fs::file_time_type write_time = fs::last_write_time(lib_path);
+    const std::uintmax_t size = fs::file_size(lib_path);
+    if (entry->library && entry->write_time == write_time && entry->size == size) {
+        return entry->library;
+    }
+
+    const fs::path copy = shadowCopy(lib_path, generations.fetch_add(1));
+    std::shared_ptr<dynalo::library> library;
+    try {
+        library = std::make_shared<dynalo::library>(copy.string());
+    } catch (...) {
+        fs::remove(copy, ec);
+        throw;
+    }
+#ifndef _WIN32
+    // The mapping outlives the name, nothing is left behind in the temp directory
+    fs::remove(copy, ec);
+#endif
+    if (entry->library) {
+        std::cout << "[PluginLoader] New build of " << lib_path << ", previous image retired\n";
+        entry->retired.push_back(std::move(entry->library));
+    }
+    entry->library = std::move(library);
+    entry->write_time = write_time;
+    entry->size = size;
+    return entry->library;
+}
 
-bool PluginManager::loadPluginLibrary(const plugin& newPlugin, ScriptManager& sm)
+bool PluginManager::loadPluginLibrary(plugin& newPlugin, ScriptManager& sm, const bool record_bindings) const
 {
     try {
-        // Load the shared library
-        dynalo::library lib(newPlugin.lib_path.string());
+        // Load the shared library, or reuse it if another session already has
+        newPlugin.lib = acquireLibrary(newPlugin.lib_path);
         
         // Get the pluginLoad function
-        auto pluginLoad = lib.get_function<bool(pluginContext&)>("pluginLoad");
+        auto pluginLoad = newPlugin.lib->get_function<bool(pluginContext&)>("pluginLoad");
         if (!pluginLoad) {
             std::cerr << "[PluginLoader] pluginLoad function not found in " << newPlugin.name << "\n";
             return false;
         }
+        newPlugin.RequiredAPI.pluginLoad.second = pluginLoad;
+        newPlugin.RequiredAPI.pluginShutdown.second = newPlugin.lib->get_function<bool(pluginContext&)>("pluginShutdown");
         
-        // Create context and call pluginLoad
-        pluginContext ctx(sm);
-        bool result = pluginLoad(ctx);
+        // The context lives as long as the plugin stays loaded in this session
+        std::vector<std::string> dependencies;
+        if (newPlugin.dependencies.is_array()) {
+            for (const json& dep : newPlugin.dependencies) {
+                if (dep.is_object() && dep.contains("name")) {
+                    dependencies.push_back(dep.value("name", std::string()));
+                }
+            }
+        }
+        newPlugin.context = std::make_unique<pluginContext>(sm, newPlugin.name, services_.get(), std::move(dependencies));
+        newPlugin.context->record_bindings(record_bindings);
+        bool result = pluginLoad(*newPlugin.context);
         
         if (result) {
             std::cout << "[PluginLoader] Successfully loaded plugin: " << newPlugin.name << "\n";
         } else {
             std::cerr << "[PluginLoader] Plugin load failed: " << newPlugin.name << "\n";
+            services_->withdraw(newPlugin.name);
+            pluginContext& ctx = *newPlugin.context;
+            sm.engine_call([&ctx](sol::state&) { ctx.reset_state(); }).get();
+            newPlugin.context.reset();
         }
         
         return result;
         
     } catch (const std::exception& e) {
         std::cerr << "[PluginLoader] Exception loading plugin " << newPlugin.name << ": " << e.what() << "\n";
+        services_->withdraw(newPlugin.name);
         return false;
     }
 }
+
+void PluginManager::shutdownPlugin(plugin& entry) const
+{
+    pluginContext& ctx = *entry.context;
+    ScriptManager& sm = *ctx.sm_;
+
+    // Names first: drop_bindings returns once every state has dropped them, so no run is still inside one of this
+    // plugin's functions when its state goes. A copy a script kept can still be called, which is why bindings hold
+    // the state through weak_state() and fail once it is reset.
+    sm.drop_bindings(entry.name);
+
+    // Shutdown runs on the engine thread, so a plugin can drop its Lua references there directly
+    try {
+        sm.engine_call([&entry, &ctx](sol::state&) {
+            if (entry.RequiredAPI.pluginShutdown.second && !entry.RequiredAPI.pluginShutdown.second(ctx)) {
+                std::cerr << "[PluginLoader] Plugin shutdown reported failure: " << entry.name << "\n";
+            }
+            ctx.reset_state();
+        }).get();
+    } catch (const std::exception& e) {
+        std::cerr << "[PluginLoader] Exception shutting down plugin " << entry.name << ": " << e.what() << "\n";
+    }
+    // Dependents are already gone, nothing can still be holding the table
+    services_->withdraw(entry.name);
+    entry.context.reset();
+    entry.loaded = false;
+}
+
+void PluginManager::unloadPlugins() const
+{
+    stopHotReload();
+    std::lock_guard lock(hotReload_->mutex);
+    for (auto name = loadOrder_->rbegin(); name != loadOrder_->rend(); ++name) {
+        auto found = GetPluginByName(*name);
+        if (!found || !found->get().context) {
+            continue;
+        }
+        shutdownPlugin(found->get());
+        std::cout << "[PluginLoader] Unloaded: " << *name << "\n";
+    }
+    loadOrder_->clear();
+}
+
+bool PluginManager::reloadPlugin(const std::string& name, ScriptManager& sm) const
+{
+    return reloadPlugins({name}, sm);
+}
+
+bool PluginManager::reloadPlugins(const std::vector<std::string>& names, ScriptManager& sm) const
+{
+    std::lock_guard lock(hotReload_->mutex);
+    const auto started = std::chrono::steady_clock::now();
+    bool ok = true;
+    std::uint64_t failures = 0;
+
+    // Open each new build before stopping anything, a broken one leaves the running version alone
+    std::unordered_set<std::string> affected;
+    for (const std::string& name : names) {
+        auto found = GetPluginByName(name);
+        if (!found || std::find(loadOrder_->begin(), loadOrder_->end(), name) == loadOrder_->end()) {
+            std::cerr << "[PluginLoader] Cannot reload " << name << ", it was never loaded in this session\n";
+            ok = false;
+            continue;
+        }
+        try {
+            acquireLibrary(found->get().lib_path);
+            affected.insert(name);
+        } catch (const std::exception& e) {
+            std::cerr << "[PluginLoader] New build of " << name << " did not open, keeping the running one: " << e.what() << "\n";
+            ++failures;
+            ok = false;
+        }
+    }
+
+    // Load order is topological, so one pass collects every transitive dependent
+    std::vector<std::reference_wrapper<plugin>> cascade;
+    for (const std::string& loadedName : *loadOrder_) {
+        plugin& entry = GetPluginByName(loadedName)->get();
+        bool hit = affected.contains(loadedName);
+        for (const json& dep : entry.dependencies) {
+            if (!hit && dep.is_object() && affected.contains(dep.value("name", std::string()))) {
+                hit = true;
+            }
+        }
+        if (hit) {
+            affected.insert(loadedName);
+            cascade.emplace_back(entry);
+        }
+    }
+
+    for (auto entry = cascade.rbegin(); entry != cascade.rend(); ++entry) {
+        if (entry->get().context) {
+            std::cout << "[PluginLoader] Reload: shutting down " << entry->get().name << "\n";
+            shutdownPlugin(*entry);
+        }
+    }
+    for (plugin& entry : cascade) {
+        bool dependenciesLoaded = true;
+        for (const json& dep : entry.dependencies) {
+            const std::string depName = dep.is_object() ? dep.value("name", std::string()) : std::string();
+            auto found = GetPluginByName(depName);
+            if (!depName.empty() && (!found || !found->get().loaded)) {
+                std::cerr << "[PluginLoader] Reload: skipping " << entry.name << ", dependency " << depName << " is not loaded\n";
+                dependenciesLoaded = false;
+                break;
+            }
+        }
+        if (dependenciesLoaded && loadPluginLibrary(entry, sm)) {
+            entry.loaded = true;
+            std::cout << "[PluginLoader] Reload: loaded " << entry.name << "\n";
+        } else {
+            ++failures;
+            ok = false;
+        }
+    }
+
+    const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    {
+        std::lock_guard statsLock(hotReload_->stats_mutex);
+        ++hotReload_->stats.reloads;
+        hotReload_->stats.failures += failures;
+        hotReload_->stats.restarted += cascade.size();
+        hotReload_->stats.last_reload_ms = elapsed;
+    }
+    std::cout << "[PluginLoader] Reload restarted " << cascade.size() << " plugins in " << elapsed << " ms\n";
+    return ok;
+}
+
+void PluginManager::startHotReload(ScriptManager& sm, const std::chrono::milliseconds debounce) const
+{
+    stopHotReload();
+
+    // Plugins loaded after this call are not watched until it is called again
+    std::vector<std::pair<fs::path, std::string>> libraries;
+    for (const std::string& name : *loadOrder_) {
+        const plugin& entry = GetPluginByName(name)->get();
+        libraries.emplace_back(entry.lib_path, entry.name);
+        hotReload_->watcher.watch(entry.lib_path);
+    }
+
+    // Runs on the watcher thread; a rebuild touching several plugins restarts their dependents once
+    hotReload_->watcher.start([this, &sm, libraries = std::move(libraries)](const std::vector<FileWatcher::Change>& changes) {
+        std::vector<std::string> rebuilt;
+        for (const auto& change : changes) {
+            for (const auto& [path, name] : libraries) {
+                if (path == change.path) {
+                    std::cout << "[PluginLoader] Library of " << name << " changed, reloading...\n";
+                    rebuilt.push_back(name);
+                }
+            }
+        }
+        if (!rebuilt.empty()) {
+            reloadPlugins(rebuilt, sm);
+        }
+    }, debounce);
+    std::cout << "[PluginLoader] Watching " << loadOrder_->size() << " plugin libraries\n";
+}
+
+void PluginManager::stopHotReload() const
+{
+    hotReload_->watcher.stop();
+}
+
+PluginManager::LibraryReloadStats PluginManager::hotReloadStats() const
+{
+    std::lock_guard lock(hotReload_->stats_mutex);
+    return hotReload_->stats;
+}
+
+void PluginManager::loadPluginsFromDir(const fs::path& plugin_dir, ScriptManager& sm) const
+{
+    if (!fs::exists(plugin_dir) || !fs::is_directory(plugin_dir)) {
+        std::cerr << "[PluginLoader] Plugin directory not found: " << plugin_dir << "\n";
+        return;
+    }
+
+    // Folders are read in parallel, then registered in directory order so duplicates resolve the same way every run
+    std::vector<fs::path> folders;
+    for (const auto& entry : fs::directory_iterator(plugin_dir)) {
+        if (entry.is_directory()) {
+            folders.push_back(entry.path());
+        }
+    }
+    std::vector<std::future<std::optional<plugin>>> parsing;
+    parsing.reserve(folders.size());
+    for (const fs::path& folder : folders) {
+        parsing.push_back(std::async(std::launch::async, [&folder] { return parsePluginMetadata(folder); }));
+    }
+    for (std::size_t i = 0; i < folders.size(); ++i) {
+        try {
+            std::optional<plugin> parsed = parsing[i].get();
+            if (!parsed) {
+                continue;
+            }
+            if (CheckIfPluginExists(parsed->name)) {
+                std::cout << "Plugin named \"" << parsed->name << "\" already exists, discarding...\n";
+                continue;
+            }
+            registerPlugin(std::move(*parsed));
+            std::cout << "[PluginLoader] Loaded plugin from " << folders[i] << "\n";
+        } catch (const std::exception& e) {
+            std::cerr << "[PluginLoader] Failed to load plugin in " << folders[i] << ": " << e.what() << "\n";
+        }
+    }
+
+    auto levels = ResolveLoadLevels();
+    if (!levels) {
+        std::cerr << "[PluginLoader] Failed to resolve plugin load order: " << levels.error() << "\n";
+        return;
+    }
+    std::cout << "[PluginLoader] Load order resolved, " << levels->size() << " dependency levels\n";
+
+    for (std::size_t depth = 0; depth < levels->size(); ++depth) {
+        std::vector<std::reference_wrapper<plugin>> ready;
+        for (plugin& entry : (*levels)[depth]) {
+            // A plugin whose dependency failed would only fail later, inside a call
+            bool dependenciesLoaded = true;
+            for (const json& dep : entry.dependencies) {
+                const std::string depName = dep.is_object() ? dep.value("name", std::string()) : std::string();
+                auto found = GetPluginByName(depName);
+                if (!depName.empty() && (!found || !found->get().loaded)) {
+                    std::cerr << "[PluginLoader] Skipping " << entry.name << ", dependency " << depName << " is not loaded\n";
+                    dependenciesLoaded = false;
+                    break;
+                }
+            }
+            if (dependenciesLoaded) {
+                ready.push_back(entry);
+            }
+        }
+
+        // dlopen, symbol lookup and pluginLoad for the whole level at once; bindings are only recorded
+        std::vector<std::future<bool>> loading;
+        loading.reserve(ready.size());
+        for (plugin& entry : ready) {
+            std::cout << "[PluginLoader] Loading: " << entry.name << " (level " << depth << ")\n";
+            loading.push_back(std::async(std::launch::async, [this, &entry, &sm] {
+                return loadPluginLibrary(entry, sm, true);
+            }));
+        }
+
+        // Applied here, in load order, before anything in the next level can depend on them
+        for (std::size_t i = 0; i < ready.size(); ++i) {
+            plugin& entry = ready[i];
+            if (!loading[i].get()) {
+                std::cerr << "[PluginLoader] Failed to load: " << entry.name << "\n";
+                continue;
+            }
+            entry.context->record_bindings(false);
+            const std::size_t bindings = entry.context->apply_recorded_bindings();
+
+            // plugin.lua files are loaded via require() in scripts, not directly executed
+            if (fs::exists(entry.luaScript_path)) {
+                std::cout << "[PluginLoader] Plugin Lua header available: " << entry.luaScript_path << "\n";
+            }
+            entry.loaded = true;
+            loadOrder_->push_back(entry.name);
+            std::cout << "[PluginLoader] Successfully loaded: " << entry.name << " (" << bindings << " bindings)\n";
+        }
+    }
+}
+
+std::expected<std::vector<std::reference_wrapper<PluginManager::plugin>>, std::string> PluginManager::ResolveLoadOrder() const
+{
+    const std::size_t count = loadedPlugins->size();
+    std::vector<std::size_t> pending(count, 0); // Dependencies not yet ordered
+    std::vector<std::vector<std::size_t>> dependents(count);
+    std::vector<std::vector<std::size_t>> dependsOn(count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const plugin& entry = (*loadedPlugins)[i];
+        if (!entry.dependencies.is_array()) {
+            return std::unexpected("Dependencies format not supported for " + entry.name);
+        }
+        for (const json& dep : entry.dependencies) {
+            if (!dep.is_object()) continue;
+            const std::string depName = dep.value("name", std::string());
+            auto found = pluginIndex->find(depName);
+            if (found == pluginIndex->end()) {
+                return std::unexpected("Missing dependency: " + entry.name + " depends on " + depName);
+            }
+            dependents[found->second].push_back(i);
+            dependsOn[i].push_back(found->second);
+            ++pending[i];
+        }
+    }
+
+    // FIFO over the ready set keeps independent plugins in registration order
+    std::vector<std::size_t> ready;
+    ready.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (pending[i] == 0) {
+            ready.push_back(i);
+        }
+    }
+    std::vector<std::reference_wrapper<plugin>> PluginLoadOrder;
+    PluginLoadOrder.reserve(count);
+    for (std::size_t head = 0; head < ready.size(); ++head) {
+        plugin& entry = (*loadedPlugins)[ready[head]];
+        PluginLoadOrder.emplace_back(entry);
+        for (const std::size_t dependent : dependents[ready[head]]) {
+            if (--pending[dependent] == 0) {
+                ready.push_back(dependent);
+            }
+        }
+    }
+    if (PluginLoadOrder.size() == count) {
+        return PluginLoadOrder;
+    }
+
+    // Every plugin left waits on another one left, so following any of those edges must come back around
+    std::size_t current = 0;
+    while (pending[current] == 0) {
+        ++current;
+    }
+    std::vector<std::size_t> visitedAt(count, count);
+    std::vector<std::size_t> path;
+    while (visitedAt[current] == count) {
+        visitedAt[current] = path.size();
+        path.push_back(current);
+        for (const std::size_t dep : dependsOn[current]) {
+            if (pending[dep] != 0) {
+                current = dep;
+                break;
+            }
+        }
+    }
+    std::string cycle = "Circular dependency: ";
+    for (std::size_t i = visitedAt[current]; i < path.size(); ++i) {
+        cycle += (*loadedPlugins)[path[i]].name + " -> ";
+    }
+    return std::unexpected(cycle + (*loadedPlugins)[current].name);
+}